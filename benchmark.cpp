@@ -0,0 +1,1434 @@
+#include "matrix.h"
+#include "affine.h"
+#include "snowflake.h"
+#include "gemm.h"
+#include "lu.h"
+#include "view.h"
+#include "parallel.h"
+#include "io.h"
+#include "generator.h"
+#include "rng.h"
+#include "rules.h"
+#include <iostream>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+
+using namespace lapiday;
+using namespace std;
+
+/**
+ * Number of heap allocations so far
+ * (by any form of operator new)
+ */
+size_t allocation_count = 0;
+
+/**
+ * Allocate memory for operator new, counting
+ * the allocation.
+ * @param size Number of bytes
+ * @return Memory
+ * @throw bad_alloc If there is no memory left
+ */
+void* counted_allocate(size_t size) {
+	allocation_count++;
+	void* p = malloc((size > 0) ? size : 1);
+	if(p == NULL) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size) {
+	return counted_allocate(size);
+}
+
+void* operator new[](size_t size) {
+	return counted_allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+#endif
+
+/**
+ * Clock used for all timings
+ */
+typedef chrono::steady_clock bench_clock;
+
+/**
+ * Get the time elapsed since the given point, in nanoseconds.
+ * @param start Starting point
+ * @return Elapsed time in nanoseconds
+ */
+double elapsed_ns(bench_clock::time_point start) {
+	return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - start).count());
+}
+
+/**
+ * Time the cost of computing one child transformation
+ * (parent * translate * rotate * scale) in different ways.
+ */
+void bench_child_transform() {
+	const size_t COUNT = 200000;
+	const double PI = 3.141592653589793;
+	double checksum = 0;
+	bench_clock::time_point start;
+
+	matrix::matrix parent = snowflake::scale(240).to_matrix();
+	matrix::matrix t = snowflake::translate(0, 0.5).to_matrix();
+	matrix::matrix r = snowflake::rotate(PI / 3).to_matrix();
+	matrix::matrix s = snowflake::scale(0.3).to_matrix();
+
+	cout << "Per-child transformation (parent * translate * rotate * scale):" << endl;
+
+	//Evaluate each product separately, as eager operators would
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix pt = parent;
+		pt *= t;
+		matrix::matrix ptr = pt;
+		ptr *= r;
+		matrix::matrix child = ptr;
+		child *= s;
+		checksum += child(1, 2);
+	}
+	cout << "  matrix, eager temporaries: " << elapsed_ns(start) / COUNT << " ns" << endl;
+
+	//Evaluate the whole chain at once
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix child = parent * t * r * s;
+		checksum += child(1, 2);
+	}
+	cout << "  matrix, lazy product: " << elapsed_ns(start) / COUNT << " ns" << endl;
+
+	//Evaluate into an existing matrix
+	matrix::matrix child;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		child = parent * t * r * s;
+		checksum += child(1, 2);
+	}
+	cout << "  matrix, lazy product into existing matrix: " << elapsed_ns(start) / COUNT << " ns" << endl;
+
+	//Fixed-size affine transformations
+	matrix::affine aparent = snowflake::scale(240);
+	matrix::affine at = snowflake::translate(0, 0.5);
+	matrix::affine ar = snowflake::rotate(PI / 3);
+	matrix::affine as = snowflake::scale(0.3);
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::affine achild = aparent * at * ar * as;
+		checksum += achild(1, 2);
+	}
+	cout << "  affine: " << elapsed_ns(start) / COUNT << " ns" << endl;
+
+	//Print the checksum so the work cannot be skipped
+	cout << "  (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Fill a vector with pseudo-random values between -1 and 1.
+ * @param v Vector to fill
+ */
+template<class T>
+void fill_random(vector<T>& v) {
+	for(size_t i = 0; i < v.size(); i++) {
+		v[i] = static_cast<T>(2 * (static_cast<double>(rand()) / RAND_MAX) - 1);
+	}
+}
+
+/**
+ * Time square matrix multiplication with the plain
+ * and blocked kernels, and check that they agree.
+ */
+void bench_gemm() {
+	const size_t SIZES[] = {64, 256, 512, 1024, 2048};
+	const size_t SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+	//The plain kernel takes too long beyond this
+	const size_t MAX_SIMPLE_SIZE = 512;
+	bench_clock::time_point start;
+
+	cout << "Square matrix multiplication (blocked kernel: " << gemm::blocked_kernel_name() << "):" << endl;
+	for(size_t s = 0; s < SIZE_COUNT; s++) {
+		size_t n = SIZES[s];
+		double flops = 2.0 * n * n * n;
+		vector<double> a(n * n);
+		vector<double> b(n * n);
+		vector<double> simple(n * n);
+		vector<double> blocked(n * n);
+		fill_random(a);
+		fill_random(b);
+
+		start = bench_clock::now();
+		gemm::multiply_blocked(a.data(), b.data(), blocked.data(), n, n, n);
+		double blocked_ns = elapsed_ns(start);
+		cout << "  n = " << n << ": blocked " << blocked_ns / 1e6 << " ms (" << flops / blocked_ns << " GFLOP/s)";
+
+		if(n <= MAX_SIMPLE_SIZE) {
+			start = bench_clock::now();
+			gemm::multiply_simple(a.data(), b.data(), simple.data(), n, n, n);
+			double simple_ns = elapsed_ns(start);
+			double maxdiff = 0;
+			for(size_t i = 0; i < n * n; i++) {
+				maxdiff = max(maxdiff, fabs(simple[i] - blocked[i]));
+			}
+			cout << ", plain " << simple_ns / 1e6 << " ms (" << flops / simple_ns << " GFLOP/s)";
+			cout << ", speedup " << simple_ns / blocked_ns << "x, max difference " << maxdiff;
+		}
+		cout << endl;
+	}
+}
+
+/**
+ * Time the determinant and inverse of random square
+ * matrices, and check the inverse.
+ */
+void bench_lu() {
+	const size_t SIZES[] = {10, 100, 500, 1000};
+	const size_t SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+	bench_clock::time_point start;
+
+	cout << "LU decomposition:" << endl;
+	for(size_t s = 0; s < SIZE_COUNT; s++) {
+		size_t n = SIZES[s];
+		vector<double> values(n * n);
+		fill_random(values);
+		matrix::matrix m(n, n);
+		for(size_t i = 0; i < n; i++) {
+			for(size_t j = 0; j < n; j++) {
+				m(i, j) = values[i * n + j];
+			}
+		}
+
+		start = bench_clock::now();
+		m.determinant();
+		double det_ns = elapsed_ns(start);
+
+		start = bench_clock::now();
+		matrix::matrix inv = m.inverse();
+		double inv_ns = elapsed_ns(start);
+
+		//The product should be the identity
+		matrix::matrix check = m * inv;
+		double maxdiff = 0;
+		for(size_t i = 0; i < n; i++) {
+			for(size_t j = 0; j < n; j++) {
+				maxdiff = max(maxdiff, fabs(check(i, j) - ((i == j) ? 1 : 0)));
+			}
+		}
+		cout << "  n = " << n << ": determinant " << det_ns / 1e6 << " ms, inverse " << inv_ns / 1e6 << " ms, max |A * inverse - I| " << maxdiff << endl;
+	}
+}
+
+/**
+ * Time solving a system for many right-hand sides,
+ * one at a time and all at once.
+ */
+void bench_solve() {
+	const size_t N = 200;
+	const size_t RHS_COUNT = 2000;
+	bench_clock::time_point start;
+	vector<double> values(N * N);
+	fill_random(values);
+	matrix::matrix m(N, N);
+	matrix::matrix rhs(N, RHS_COUNT);
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			m(i, j) = values[i * N + j];
+		}
+		for(size_t j = 0; j < RHS_COUNT; j++) {
+			rhs(i, j) = values[(i * RHS_COUNT + j) % (N * N)];
+		}
+	}
+
+	cout << "Solving with n = " << N << " and " << RHS_COUNT << " right-hand sides:" << endl;
+	start = bench_clock::now();
+	matrix::lu decomposition(m);
+	cout << "  decomposition: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+
+	//One column at a time
+	matrix::matrix column(N, 1);
+	start = bench_clock::now();
+	for(size_t j = 0; j < RHS_COUNT; j++) {
+		for(size_t i = 0; i < N; i++) {
+			column(i, 0) = rhs(i, j);
+		}
+		decomposition.solve_in_place(column);
+	}
+	cout << "  one at a time: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+
+	//All columns together
+	start = bench_clock::now();
+	matrix::matrix solutions = decomposition.solve(rhs);
+	cout << "  batched: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+
+	matrix::matrix check = m * solutions;
+	double maxdiff = 0;
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < RHS_COUNT; j++) {
+			maxdiff = max(maxdiff, fabs(check(i, j) - rhs(i, j)));
+		}
+	}
+	cout << "  max |A * X - B| " << maxdiff << endl;
+}
+
+/**
+ * Time raising a stochastic (Markov) matrix to large powers,
+ * and compare a small power with repeated multiplication.
+ */
+void bench_power() {
+	const size_t N = 50;
+	const int EXPONENTS[] = {1000, 1000000, 1000000000};
+	const size_t EXPONENT_COUNT = sizeof(EXPONENTS) / sizeof(EXPONENTS[0]);
+	bench_clock::time_point start;
+
+	//Each row sums to 1
+	vector<double> values(N * N);
+	fill_random(values);
+	matrix::matrix m(N, N);
+	for(size_t i = 0; i < N; i++) {
+		double sum = 0;
+		for(size_t j = 0; j < N; j++) {
+			m(i, j) = fabs(values[i * N + j]);
+			sum += m(i, j);
+		}
+		for(size_t j = 0; j < N; j++) {
+			m(i, j) /= sum;
+		}
+	}
+
+	cout << "Powers of a " << N << " x " << N << " stochastic matrix:" << endl;
+	for(size_t e = 0; e < EXPONENT_COUNT; e++) {
+		start = bench_clock::now();
+		matrix::matrix p = m ^ EXPONENTS[e];
+		cout << "  exponent " << EXPONENTS[e] << ": " << elapsed_ns(start) / 1e6 << " ms (entry (0, 0) = " << p(0, 0) << ")" << endl;
+	}
+
+	//Repeated multiplication for comparison
+	start = bench_clock::now();
+	matrix::matrix repeated(N);
+	for(int i = 0; i < EXPONENTS[0]; i++) {
+		repeated *= m;
+	}
+	double repeated_ns = elapsed_ns(start);
+	matrix::matrix squared = m ^ EXPONENTS[0];
+	double maxdiff = 0;
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			maxdiff = max(maxdiff, fabs(repeated(i, j) - squared(i, j)));
+		}
+	}
+	cout << "  exponent " << EXPONENTS[0] << " by repeated multiplication: " << repeated_ns / 1e6 << " ms, max difference " << maxdiff << endl;
+}
+
+/**
+ * Time products and inverses of matrices with a known
+ * structure against the same matrices tagged as general.
+ */
+void bench_structure() {
+	const size_t COUNT = 200000;
+	const size_t SIZES[] = {3, 500};
+	const size_t SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+	const double PI = 3.141592653589793;
+	double checksum = 0;
+	bench_clock::time_point start;
+
+	cout << "Structured products (multiplications per product in brackets):" << endl;
+	for(size_t s = 0; s < SIZE_COUNT; s++) {
+		size_t n = SIZES[s];
+		size_t count = (n <= 3) ? COUNT : 4;
+		//Random affine matrices
+		vector<double> values(2 * n * n);
+		fill_random(values);
+		matrix::matrix first(n, n);
+		matrix::matrix second(n, n);
+		for(size_t i = 0; i + 1 < n; i++) {
+			for(size_t j = 0; j < n; j++) {
+				first(i, j) = values[i * n + j];
+				second(i, j) = values[n * n + i * n + j];
+			}
+		}
+		first(n - 1, n - 1) = 1;
+		second(n - 1, n - 1) = 1;
+		first.detect_structure();
+		second.detect_structure();
+		matrix::matrix first_general = first;
+		matrix::matrix second_general = second;
+		first_general.assume_structure(matrix::structure_general);
+		second_general.assume_structure(matrix::structure_general);
+		matrix::matrix out;
+		//Small affine products skip the last row and the
+		//last inner index, while large ones run the same
+		//blocked product as general matrices
+		size_t general_flops = n * n * n;
+		bool fast = ((n - 1) * n * n < gemm::BLOCKED_MIN_WORK);
+		size_t affine_flops = fast ? (n - 1) * (n - 1) * n : general_flops;
+
+		start = bench_clock::now();
+		for(size_t i = 0; i < count; i++) {
+			out = first_general * second_general;
+			checksum += out(0, 0);
+		}
+		cout << "  " << n << " x " << n << " general: " << elapsed_ns(start) / count << " ns (" << general_flops << ")" << endl;
+
+		start = bench_clock::now();
+		for(size_t i = 0; i < count; i++) {
+			out = first * second;
+			checksum += out(0, 0);
+		}
+		cout << "  " << n << " x " << n << " affine" << (fast ? "" : " (no fast path)") << ": " << elapsed_ns(start) / count << " ns (" << affine_flops << ")" << endl;
+	}
+
+	//Inverse of a rotation and translation
+	matrix::matrix rigid = (snowflake::translate(3, 4) * snowflake::rotate(PI / 3)).to_matrix();
+	rigid.assume_structure(matrix::structure_rigid);
+	matrix::matrix rigid_general = rigid;
+	rigid_general.assume_structure(matrix::structure_general);
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		checksum += rigid_general.inverse()(0, 2);
+	}
+	cout << "  3 x 3 inverse, general (LU): " << elapsed_ns(start) / COUNT << " ns" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		checksum += rigid.inverse()(0, 2);
+	}
+	cout << "  3 x 3 inverse, rigid (transpose): " << elapsed_ns(start) / COUNT << " ns" << endl;
+	cout << "  (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Time products with a transposed factor and the adjoint of
+ * a singular matrix, with copies and with views.
+ */
+void bench_views() {
+	const size_t N = 500;
+	const size_t ADJOINT_N = 40;
+	bench_clock::time_point start;
+
+	vector<double> values(2 * N * N);
+	fill_random(values);
+	matrix::matrix first(N, N);
+	matrix::matrix second(N, N);
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			first(i, j) = values[i * N + j];
+			second(i, j) = values[N * N + i * N + j];
+		}
+	}
+	const matrix::matrix& constfirst = first;
+
+	cout << "Copies and views:" << endl;
+	start = bench_clock::now();
+	matrix::matrix copied = first.transpose() * second;
+	cout << "  " << N << " x " << N << " transpose times matrix, copied transpose: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	start = bench_clock::now();
+	matrix::matrix viewed = constfirst.view().transpose() * second;
+	cout << "  " << N << " x " << N << " transpose times matrix, transposed view: " << elapsed_ns(start) / 1e6 << " ms (equal: " << (copied == viewed) << ")" << endl;
+
+	//Rank n - 1, so the adjoint needs every minor
+	matrix::matrix singular(ADJOINT_N, ADJOINT_N);
+	for(size_t i = 0; i < ADJOINT_N; i++) {
+		for(size_t j = 0; j < ADJOINT_N; j++) {
+			singular(i, j) = (i + 1 < ADJOINT_N) ? values[i * ADJOINT_N + j] : 0;
+		}
+	}
+	start = bench_clock::now();
+	matrix::matrix adjoint = singular.adjoint();
+	cout << "  adjoint of a singular " << ADJOINT_N << " x " << ADJOINT_N << " matrix: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+}
+
+/**
+ * Time transforming many points with one transformation,
+ * one point at a time and in bulk.
+ */
+void bench_points() {
+	const size_t COUNT = 4000000;
+	bench_clock::time_point start;
+	vector<double> x(COUNT);
+	vector<double> y(COUNT);
+	vector<double> outx(COUNT);
+	vector<double> outy(COUNT);
+	fill_random(x);
+	fill_random(y);
+	matrix::affine t = snowflake::translate(250, 250) * snowflake::rotate(0.5) * snowflake::scale(240);
+
+	cout << "Transforming " << COUNT << " points:" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		t.apply(x[i], y[i], outx[i], outy[i]);
+	}
+	cout << "  one at a time: " << elapsed_ns(start) / COUNT << " ns per point" << endl;
+
+	start = bench_clock::now();
+	transform_points(t, &x[0], &y[0], &outx[0], &outy[0], COUNT);
+	cout << "  in bulk: " << elapsed_ns(start) / COUNT << " ns per point" << endl;
+}
+
+/**
+ * Time generating the nonrandom snowflake, one product
+ * per child line and in bulk.
+ */
+void bench_expand() {
+	const unsigned int LEVELS = 7;
+	const double PI = 3.141592653589793;
+	const double THIRD = 1.0 / 3;
+	const size_t CHILD_COUNT = 7;
+	bench_clock::time_point start;
+	double checksum = 0;
+
+	vector<snowflake::line> seed;
+	for(int i = 0; i < 6; i++) {
+		seed.push_back(snowflake::line(snowflake::rotate(PI / 3 * i) * snowflake::scale(240)));
+	}
+
+	cout << "Generating " << LEVELS << " levels of the nonrandom snowflake:" << endl;
+
+	//One product per child line
+	vector<snowflake::line> lines = seed;
+	vector<snowflake::line> newlines;
+	start = bench_clock::now();
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		for(size_t j = 0; j < lines.size(); j++) {
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::scale(THIRD)));
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, THIRD) * snowflake::scale(THIRD)));
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD)));
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD)));
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)));
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD)));
+			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)));
+		}
+		lines.swap(newlines);
+		newlines.clear();
+	}
+	double single_ns = elapsed_ns(start);
+	checksum += lines.back().transformation(0, 2);
+	cout << "  one product per line: " << single_ns / 1e6 << " ms (" << single_ns / lines.size() << " ns per line)" << endl;
+
+	//All children of all lines in bulk
+	const matrix::affine children[CHILD_COUNT] = {
+		snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)
+	};
+	lines = seed;
+	newlines.clear();
+	start = bench_clock::now();
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		newlines.resize(lines.size() * CHILD_COUNT);
+		snowflake::expand(&lines[0], lines.size(), children, CHILD_COUNT, &newlines[0]);
+		lines.swap(newlines);
+	}
+	double bulk_ns = elapsed_ns(start);
+	checksum += lines.back().transformation(0, 2);
+	cout << "  in bulk: " << bulk_ns / 1e6 << " ms (" << bulk_ns / lines.size() << " ns per line)" << endl;
+	cout << "  (" << lines.size() << " lines, checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Time one blocked multiplication of random square matrices.
+ * @param n Size of the matrices
+ * @return Elapsed time in nanoseconds
+ */
+template<class T>
+double time_gemm(size_t n) {
+	vector<T> a(n * n);
+	vector<T> b(n * n);
+	vector<T> c(n * n);
+	fill_random(a);
+	fill_random(b);
+	bench_clock::time_point start = bench_clock::now();
+	gemm::multiply_blocked(a.data(), b.data(), c.data(), n, n, n);
+	return elapsed_ns(start);
+}
+
+/**
+ * Time transforming random points in bulk.
+ * @param count Number of points
+ * @return Elapsed time in nanoseconds
+ */
+template<class T>
+double time_points(size_t count) {
+	vector<T> x(count);
+	vector<T> y(count);
+	fill_random(x);
+	fill_random(y);
+	matrix::basic_affine<T> t(snowflake::translate(250, 250) * snowflake::rotate(0.5) * snowflake::scale(240));
+	bench_clock::time_point start = bench_clock::now();
+	transform_points(t, &x[0], &y[0], &x[0], &y[0], count);
+	return elapsed_ns(start);
+}
+
+/**
+ * Time generating the nonrandom snowflake in bulk and
+ * finding the endpoints of its lines, as when drawing.
+ * @param levels Number of levels
+ * @param maxdiff Set to the largest difference between the
+ * endpoints and the same endpoints computed in double
+ * @return Elapsed time in nanoseconds
+ */
+template<class T>
+double time_snowflake(unsigned int levels, double& maxdiff) {
+	const double PI = 3.141592653589793;
+	const double THIRD = 1.0 / 3;
+	const size_t CHILD_COUNT = 7;
+	//Built in double, then rounded once
+	const matrix::affine children[CHILD_COUNT] = {
+		snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)
+	};
+	matrix::basic_affine<T> converted[CHILD_COUNT];
+	for(size_t k = 0; k < CHILD_COUNT; k++) {
+		converted[k] = matrix::basic_affine<T>(children[k]);
+	}
+	vector<snowflake::basic_line<T> > lines;
+	vector<snowflake::basic_line<T> > newlines;
+	for(int i = 0; i < 6; i++) {
+		lines.push_back(snowflake::basic_line<T>(matrix::basic_affine<T>(snowflake::rotate(PI / 3 * i) * snowflake::scale(240))));
+	}
+
+	bench_clock::time_point start = bench_clock::now();
+	for(unsigned int i = 0; i < levels; i++) {
+		newlines.resize(lines.size() * CHILD_COUNT);
+		snowflake::expand(&lines[0], lines.size(), converted, CHILD_COUNT, &newlines[0]);
+		lines.swap(newlines);
+	}
+	size_t count = lines.size();
+	vector<T> x0(count);
+	vector<T> y0(count);
+	vector<T> x1(count);
+	vector<T> y1(count);
+	snowflake::endpoints(&lines[0], count, &x0[0], &y0[0], &x1[0], &y1[0]);
+	double ns = elapsed_ns(start);
+
+	//Compare the tip of the last line with the double result
+	snowflake::line last(matrix::affine(snowflake::rotate(PI / 3 * 5) * snowflake::scale(240)));
+	for(unsigned int i = 0; i < levels; i++) {
+		last = snowflake::line(last.transformation * children[CHILD_COUNT - 1]);
+	}
+	double x, y;
+	last.transformation.apply(0, 1, x, y);
+	maxdiff = max(fabs(x1[count - 1] - x), fabs(y1[count - 1] - y));
+	return ns;
+}
+
+/**
+ * Time the same work with float and double entries.
+ */
+void bench_float() {
+	const size_t GEMM_SIZE = 1024;
+	const size_t POINT_COUNT = 4000000;
+	const unsigned int LEVELS = 7;
+	double float_ns;
+	double double_ns;
+	double float_diff;
+	double double_diff;
+
+	cout << "Float versus double:" << endl;
+	float_ns = time_gemm<float>(GEMM_SIZE);
+	double_ns = time_gemm<double>(GEMM_SIZE);
+	cout << "  multiplication (n = " << GEMM_SIZE << "): float " << float_ns / 1e6 << " ms, double " << double_ns / 1e6 << " ms, speedup " << double_ns / float_ns << "x" << endl;
+
+	float_ns = time_points<float>(POINT_COUNT);
+	double_ns = time_points<double>(POINT_COUNT);
+	cout << "  transforming " << POINT_COUNT << " points: float " << float_ns / POINT_COUNT << " ns, double " << double_ns / POINT_COUNT << " ns per point, speedup " << double_ns / float_ns << "x" << endl;
+
+	float_ns = time_snowflake<float>(LEVELS, float_diff);
+	double_ns = time_snowflake<double>(LEVELS, double_diff);
+	cout << "  snowflake (" << LEVELS << " levels, with endpoints): float " << float_ns / 1e6 << " ms, double " << double_ns / 1e6 << " ms, speedup " << double_ns / float_ns << "x" << endl;
+	cout << "  (last tip differs from double by " << float_diff << " in float, " << double_diff << " in double)" << endl;
+}
+
+/**
+ * Count heap allocations per operation for small matrices,
+ * which keep their entries inside the object, and for a
+ * matrix just too large for that.
+ */
+void bench_allocations() {
+	const size_t COUNT = 200000;
+	const double PI = 3.141592653589793;
+	double checksum = 0;
+	bench_clock::time_point start;
+	size_t allocations;
+
+	matrix::matrix parent = snowflake::scale(240).to_matrix();
+	matrix::matrix t = snowflake::translate(0, 0.5).to_matrix();
+	matrix::matrix r = snowflake::rotate(PI / 3).to_matrix();
+	matrix::matrix s = snowflake::scale(0.3).to_matrix();
+	matrix::matrix general(4, 4);
+	matrix::matrix large(5, 5);
+	vector<double> values(2 * 5 * 5);
+	fill_random(values);
+	for(size_t i = 0; i < 5; i++) {
+		for(size_t j = 0; j < 5; j++) {
+			large(i, j) = values[i * 5 + j];
+			if((i < 4) && (j < 4)) {
+				general(i, j) = values[25 + i * 5 + j];
+			}
+		}
+	}
+
+	cout << "Heap allocations (entries up to 4 x 4 are stored inline):" << endl;
+	allocations = allocation_count;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix child = parent * t * r * s;
+		checksum += child(1, 2);
+	}
+	cout << "  3 x 3 product of four: " << elapsed_ns(start) / COUNT << " ns, " << static_cast<double>(allocation_count - allocations) / COUNT << " allocations" << endl;
+
+	allocations = allocation_count;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix copy = r;
+		copy = copy.transpose();
+		checksum += copy(0, 1);
+	}
+	cout << "  3 x 3 copy and transpose: " << elapsed_ns(start) / COUNT << " ns, " << static_cast<double>(allocation_count - allocations) / COUNT << " allocations" << endl;
+
+	allocations = allocation_count;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		checksum += general.inverse()(0, 0);
+	}
+	cout << "  4 x 4 inverse (LU): " << elapsed_ns(start) / COUNT << " ns, " << static_cast<double>(allocation_count - allocations) / COUNT << " allocations" << endl;
+
+	allocations = allocation_count;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix product = large * large;
+		checksum += product(0, 0);
+	}
+	cout << "  5 x 5 product: " << elapsed_ns(start) / COUNT << " ns, " << static_cast<double>(allocation_count - allocations) / COUNT << " allocations" << endl;
+	cout << "  (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Time copying a large matrix with and without
+ * copy-on-write, when the copy is only read and
+ * when it is changed.
+ */
+void bench_copy_on_write() {
+	const size_t N = 512;
+	const size_t COUNT = 1000;
+	double checksum = 0;
+	bench_clock::time_point start;
+	vector<double> values(N * N);
+	fill_random(values);
+	matrix::matrix m(N, N);
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			m(i, j) = values[i * N + j];
+		}
+	}
+	matrix::matrix shared = m;
+	shared.set_copy_on_write(true);
+
+	cout << "Copying a " << N << " x " << N << " matrix:" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix copy = m;
+		checksum += static_cast<const matrix::matrix&>(copy)(0, 0);
+	}
+	cout << "  read only, deep copy: " << elapsed_ns(start) / COUNT << " ns" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix copy = shared;
+		checksum += static_cast<const matrix::matrix&>(copy)(0, 0);
+	}
+	cout << "  read only, copy-on-write: " << elapsed_ns(start) / COUNT << " ns" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix copy = m;
+		copy(0, 0) = 1;
+		checksum += copy(0, 0);
+	}
+	cout << "  changed, deep copy: " << elapsed_ns(start) / COUNT << " ns" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		matrix::matrix copy = shared;
+		copy(0, 0) = 1;
+		checksum += copy(0, 0);
+	}
+	cout << "  changed, copy-on-write: " << elapsed_ns(start) / COUNT << " ns" << endl;
+	cout << "  (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Time reading and scaling every entry of a matrix
+ * through the checked and unchecked accessors.
+ */
+void bench_access() {
+	const size_t N = 1024;
+	double checksum = 0;
+	bench_clock::time_point start;
+	vector<double> values(N * N);
+	fill_random(values);
+	matrix::matrix m(N, N);
+	copy(values.begin(), values.end(), m.data());
+	const matrix::matrix& cm = m;
+
+	cout << "Reading and scaling the entries of a " << N << " x " << N << " matrix:" << endl;
+	double sum = 0;
+	start = bench_clock::now();
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			sum += cm(i, j);
+		}
+	}
+	cout << "  read, operator(): " << elapsed_ns(start) / (N * N) << " ns per entry" << endl;
+	checksum += sum;
+	sum = 0;
+	start = bench_clock::now();
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			sum += cm.unchecked(i, j);
+		}
+	}
+	cout << "  read, unchecked(): " << elapsed_ns(start) / (N * N) << " ns per entry" << endl;
+	checksum += sum;
+	sum = 0;
+	start = bench_clock::now();
+	for(size_t i = 0; i < N; i++) {
+		matrix::matrix::const_row_iterator end = cm.row_end(i);
+		for(matrix::matrix::const_row_iterator p = cm.row_begin(i); p != end; ++p) {
+			sum += *p;
+		}
+	}
+	cout << "  read, row iterators: " << elapsed_ns(start) / (N * N) << " ns per entry" << endl;
+	checksum += sum;
+
+	start = bench_clock::now();
+	for(size_t i = 0; i < N; i++) {
+		for(size_t j = 0; j < N; j++) {
+			m(i, j) *= 0.5;
+		}
+	}
+	cout << "  scale, operator(): " << elapsed_ns(start) / (N * N) << " ns per entry" << endl;
+	start = bench_clock::now();
+	double* entries = m.data();
+	for(size_t i = 0; i < N * N; i++) {
+		entries[i] *= 2;
+	}
+	cout << "  scale, data(): " << elapsed_ns(start) / (N * N) << " ns per entry" << endl;
+	checksum += cm.unchecked(N - 1, N - 1);
+	cout << "  (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Time large products and element-wise operations
+ * with different numbers of threads, and check that
+ * the results do not depend on the number of threads.
+ */
+void bench_parallel() {
+	const size_t N = 1024;
+	const size_t COUNT = 10;
+	bench_clock::time_point start;
+	vector<double> values(N * N);
+	fill_random(values);
+	matrix::matrix a(N, N);
+	copy(values.begin(), values.end(), a.data());
+	matrix::matrix b = a.transpose();
+	matrix::matrix first_product;
+	matrix::matrix first_sum;
+	size_t counts[] = {1, 2, 0};
+
+	cout << "Threads for " << N << " x " << N << " matrices:" << endl;
+	for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		parallel::set_thread_count(counts[c]);
+		size_t threads = parallel::thread_count();
+		start = bench_clock::now();
+		matrix::matrix product = a * b;
+		cout << "  " << threads << " thread(s), product: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+		matrix::matrix sum;
+		start = bench_clock::now();
+		for(size_t i = 0; i < COUNT; i++) {
+			sum = a;
+			sum += b;
+			sum *= 0.5;
+			sum = sum.transpose();
+		}
+		cout << "  " << threads << " thread(s), add, scale and transpose: " << elapsed_ns(start) / 1e6 / COUNT << " ms" << endl;
+		if(c == 0) {
+			first_product = product;
+			first_sum = sum;
+		} else if((product != first_product) || (sum != first_sum)) {
+			cout << "  results differ from 1 thread" << endl;
+		}
+	}
+	parallel::set_thread_count(0);
+}
+
+/**
+ * Time saving a large matrix as text and in the binary
+ * format, reading it back, and mapping it into memory.
+ */
+void bench_io() {
+	const size_t N = 1024;
+	const char* TEXT_PATH = "benchmark_matrix.txt";
+	const char* BINARY_PATH = "benchmark_matrix.lpm";
+	bench_clock::time_point start;
+	vector<double> values(N * N);
+	fill_random(values);
+	matrix::matrix m(N, N);
+	copy(values.begin(), values.end(), m.data());
+
+	cout << "Saving and loading a " << N << " x " << N << " matrix:" << endl;
+	start = bench_clock::now();
+	{
+		ofstream out(TEXT_PATH);
+		out << m;
+	}
+	cout << "  write text: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	start = bench_clock::now();
+	{
+		ofstream out(BINARY_PATH, ios::binary);
+		matrix::write_binary(out, m);
+	}
+	cout << "  write binary: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	matrix::matrix loaded;
+	start = bench_clock::now();
+	{
+		ifstream in(BINARY_PATH, ios::binary);
+		matrix::read_binary(in, loaded);
+	}
+	cout << "  read binary: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	start = bench_clock::now();
+	double entry;
+	{
+		matrix::mapped_matrix mapped(BINARY_PATH);
+		entry = mapped(N - 1, N - 1);
+	}
+	cout << "  map binary and read one entry: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	if((loaded != m) || (entry != m(N - 1, N - 1))) {
+		cout << "  binary file does not match" << endl;
+	}
+	remove(TEXT_PATH);
+	remove(BINARY_PATH);
+}
+
+/**
+ * Fill in random children for a line, like main.cpp.
+ * @param children Array for the children
+ * @param pairs Number of pairs of children
+ */
+void random_children(matrix::affine* children, unsigned int pairs) {
+	const double PI = 3.141592653589793;
+	for(unsigned int k = 0; k < pairs; k++) {
+		double distance = ((static_cast<double>(rand()) / RAND_MAX) + k) / pairs;
+		double scale = 0.25 + (static_cast<double>(rand()) / RAND_MAX) / 12;
+		children[2 * k] = snowflake::translate(0, distance) * snowflake::rotate(PI / 3) * snowflake::scale(scale);
+		children[2 * k + 1] = snowflake::translate(0, distance) * snowflake::rotate(-PI / 3) * snowflake::scale(scale);
+	}
+}
+
+/**
+ * Time growing a random spoke by rescanning every line
+ * for ones without children, and with the generator,
+ * which only visits the newest level.
+ */
+void bench_generate() {
+	const unsigned int LEVELS = 8;
+	const unsigned int PAIRS = 2;
+	const size_t CHILD_COUNT = 2 * PAIRS;
+	bench_clock::time_point start;
+	snowflake::line seed(snowflake::scale(240));
+	matrix::affine children[CHILD_COUNT];
+
+	cout << "Growing " << LEVELS << " levels of a random spoke:" << endl;
+	srand(1);
+	start = bench_clock::now();
+	vector<snowflake::line> lines(1, seed);
+	vector<bool> completed(1, false);
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		size_t count = lines.size();
+		for(size_t j = 0; j < count; j++) {
+			if(!completed[j]) {
+				random_children(children, PAIRS);
+				size_t first = lines.size();
+				lines.resize(first + CHILD_COUNT);
+				completed.resize(first + CHILD_COUNT, false);
+				snowflake::expand(&lines[j], 1, children, CHILD_COUNT, &lines[first]);
+				completed[j] = true;
+			}
+		}
+	}
+	cout << "  rescanning all lines: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+
+	srand(1);
+	start = bench_clock::now();
+	snowflake::generator spoke(seed, CHILD_COUNT, LEVELS);
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		spoke.grow([&](const snowflake::line&, matrix::affine* out) {
+			random_children(out, PAIRS);
+		});
+	}
+	cout << "  generator: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	cout << "  (" << spoke.lines().size() << " lines, reserved " << snowflake::generator::line_count(CHILD_COUNT, LEVELS) << ")" << endl;
+	if(spoke.lines().back().transformation != lines.back().transformation) {
+		cout << "  generator lines differ" << endl;
+	}
+}
+
+/**
+ * Time generating snowflakes with different numbers
+ * of threads, and check that the lines do not depend
+ * on the number of threads.
+ */
+void bench_parallel_generate() {
+	const unsigned int LEVELS = 8;
+	const double PI = 3.141592653589793;
+	const double THIRD = 1.0 / 3;
+	const size_t CHILD_COUNT = 7;
+	const unsigned int RANDOM_LEVELS = 10;
+	const size_t RANDOM_CHILD_COUNT = 4;
+	bench_clock::time_point start;
+	const matrix::affine children[CHILD_COUNT] = {
+		snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)
+	};
+	//Children that depend only on where the parent is,
+	//with uneven amounts of work
+	snowflake::generator::indexed_rule rule = [=](const snowflake::line&, size_t level, size_t index, matrix::affine* out) {
+		size_t hash = (index * 2654435761u + level) % 1000;
+		double distance = 0.25 + hash / 2000.0;
+		for(size_t k = 0; k < (index % 4) * 8; k++) {
+			distance = distance * 0.999 + 0.0001;
+		}
+		for(size_t k = 0; k < RANDOM_CHILD_COUNT; k++) {
+			out[k] = snowflake::translate(0, distance) * snowflake::rotate((k % 2 == 0) ? PI / 3 : -PI / 3) * snowflake::scale(0.3);
+		}
+	};
+	vector<snowflake::line> first_lines;
+	vector<snowflake::line> first_random;
+	size_t counts[] = {1, 2, 0};
+
+	cout << "Threads for snowflake generation:" << endl;
+	for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		parallel::set_thread_count(counts[c]);
+		size_t threads = parallel::thread_count();
+		snowflake::generator nonrandom(snowflake::line(snowflake::scale(240)), CHILD_COUNT, LEVELS);
+		start = bench_clock::now();
+		for(unsigned int i = 0; i < LEVELS; i++) {
+			nonrandom.grow(children);
+		}
+		cout << "  " << threads << " thread(s), " << LEVELS << " nonrandom levels: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+		snowflake::generator random(snowflake::line(snowflake::scale(240)), RANDOM_CHILD_COUNT, RANDOM_LEVELS);
+		start = bench_clock::now();
+		for(unsigned int i = 0; i < RANDOM_LEVELS; i++) {
+			random.grow_parallel(rule);
+		}
+		cout << "  " << threads << " thread(s), " << RANDOM_LEVELS << " levels with a rule: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+		if(c == 0) {
+			first_lines = nonrandom.lines();
+			first_random = random.lines();
+		} else {
+			for(size_t i = 0; i < first_lines.size(); i++) {
+				if(nonrandom.lines()[i].transformation != first_lines[i].transformation) {
+					cout << "  nonrandom lines differ from 1 thread" << endl;
+					break;
+				}
+			}
+			for(size_t i = 0; i < first_random.size(); i++) {
+				if(random.lines()[i].transformation != first_random[i].transformation) {
+					cout << "  lines from the rule differ from 1 thread" << endl;
+					break;
+				}
+			}
+		}
+	}
+	parallel::set_thread_count(0);
+}
+
+/**
+ * Time drawing random numbers with rand() and with
+ * the keyed generator used by main.cpp.
+ */
+void bench_rng() {
+	const size_t COUNT = 10000000;
+	const size_t LINES = 1000000;
+	bench_clock::time_point start;
+	double sum = 0;
+
+	cout << "Drawing " << COUNT << " random numbers:" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		sum += static_cast<double>(rand()) / RAND_MAX;
+	}
+	cout << "  rand(): " << elapsed_ns(start) / COUNT << " ns per number" << endl;
+	rng::splitmix numbers(1, 0, 0);
+	start = bench_clock::now();
+	for(size_t i = 0; i < COUNT; i++) {
+		sum += numbers.uniform();
+	}
+	cout << "  splitmix: " << elapsed_ns(start) / COUNT << " ns per number" << endl;
+	start = bench_clock::now();
+	for(size_t i = 0; i < LINES; i++) {
+		rng::splitmix line_numbers(1, 4, i);
+		sum += line_numbers.uniform() + line_numbers.uniform();
+	}
+	cout << "  splitmix, two numbers per line key: " << elapsed_ns(start) / LINES << " ns per line" << endl;
+	cout << "  (checksum " << sum << ")" << endl;
+}
+
+/**
+ * Time finding the last level of the nonrandom snowflake
+ * by storing every level, and by walking it depth-first
+ * in batches.
+ */
+void bench_walk() {
+	const unsigned int LEVELS = 7;
+	const double PI = 3.141592653589793;
+	const double THIRD = 1.0 / 3;
+	const size_t CHILD_COUNT = 7;
+	const size_t BATCH_SIZE = 4096;
+	bench_clock::time_point start;
+	const matrix::affine children[CHILD_COUNT] = {
+		snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)
+	};
+	vector<snowflake::line> seeds;
+	for(int i = 0; i < 6; i++) {
+		seeds.push_back(snowflake::line(snowflake::rotate(PI / 3 * i) * snowflake::scale(240)));
+	}
+
+	cout << "Finding the lines of level " << LEVELS << " of the nonrandom snowflake:" << endl;
+	start = bench_clock::now();
+	vector<snowflake::line> lines = seeds;
+	vector<snowflake::line> newlines;
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		newlines.resize(lines.size() * CHILD_COUNT);
+		snowflake::expand(&lines[0], lines.size(), children, CHILD_COUNT, &newlines[0]);
+		lines.swap(newlines);
+	}
+	double x0 = 0;
+	double y0 = 0;
+	for(size_t i = 0; i < lines.size(); i++) {
+		x0 += lines[i].transformation(0, 2);
+		y0 += lines[i].transformation(1, 2);
+	}
+	cout << "  storing every level: " << elapsed_ns(start) / 1e6 << " ms, " << lines.size() + newlines.size() << " lines stored" << endl;
+
+	start = bench_clock::now();
+	snowflake::walker walker(&seeds[0], seeds.size(), children, CHILD_COUNT, LEVELS);
+	vector<snowflake::line> batch(BATCH_SIZE);
+	size_t count;
+	size_t total = 0;
+	double x1 = 0;
+	double y1 = 0;
+	while((count = walker.next_batch(&batch[0], BATCH_SIZE)) > 0) {
+		for(size_t i = 0; i < count; i++) {
+			x1 += batch[i].transformation(0, 2);
+			y1 += batch[i].transformation(1, 2);
+		}
+		total += count;
+	}
+	cout << "  walking depth-first: " << elapsed_ns(start) / 1e6 << " ms, " << BATCH_SIZE + LEVELS << " lines stored" << endl;
+	if((total != lines.size()) || (x0 != x1) || (y0 != y1)) {
+		cout << "  walked lines differ" << endl;
+	}
+}
+
+/**
+ * Time copying a spoke to the other five spokes, which
+ * instancing with snowflake::symmetry() avoids.
+ */
+void bench_symmetry() {
+	const unsigned int LEVELS = 7;
+	const double PI = 3.141592653589793;
+	const double THIRD = 1.0 / 3;
+	const size_t CHILD_COUNT = 7;
+	bench_clock::time_point start;
+	const matrix::affine children[CHILD_COUNT] = {
+		snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD),
+		snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)
+	};
+	snowflake::generator spoke(snowflake::line(snowflake::scale(240)), CHILD_COUNT, LEVELS);
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		spoke.grow(children);
+	}
+	const vector<snowflake::line>& lines = spoke.lines();
+
+	cout << "Making six spokes from one with " << lines.size() << " lines:" << endl;
+	start = bench_clock::now();
+	vector<snowflake::line> copies;
+	copies.reserve(6 * lines.size());
+	copies = lines;
+	for(size_t i = 0; i < lines.size(); i++) {
+		for(int j = 1; j < 6; j++) {
+			copies.push_back(snowflake::line(snowflake::rotate(PI / 3 * j) * lines[i].transformation));
+		}
+	}
+	cout << "  copying lines: " << elapsed_ns(start) / 1e6 << " ms, " << copies.size() << " lines stored" << endl;
+	start = bench_clock::now();
+	vector<matrix::affine> instances = snowflake::symmetry(6);
+	cout << "  instancing: " << elapsed_ns(start) / 1e6 << " ms, " << lines.size() << " lines and " << instances.size() << " instances stored" << endl;
+}
+
+/**
+ * Parameters of the random branching in bench_static_rules()
+ */
+struct bench_branching {
+	static constexpr unsigned int PAIRS = 2;
+	static constexpr double MIN_SCALE = 0.25;
+	static constexpr double MAX_SCALE = 1.0 / 3;
+	static constexpr double ANGLE = 3.141592653589793 / 3;
+};
+
+/**
+ * Time growing a random spoke with children built from
+ * products of scale, rotate and translate matrices for
+ * every line, and with a branching rule set.
+ */
+void bench_rules() {
+	const unsigned int LEVELS = 9;
+	const unsigned int PAIRS = 2;
+	const double PI = 3.141592653589793;
+	const uint64_t SEED = 1;
+	bench_clock::time_point start;
+	snowflake::line seed(snowflake::scale(240));
+
+	cout << "Growing " << LEVELS << " levels of a random spoke:" << endl;
+	start = bench_clock::now();
+	snowflake::generator products(seed, 2 * PAIRS, LEVELS);
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		products.grow_parallel([&](const snowflake::line&, size_t level, size_t index, matrix::affine* children) {
+			rng::splitmix numbers(SEED, level, index);
+			for(unsigned int k = 0; k < PAIRS; k++) {
+				double distance = (numbers.uniform() + k) / PAIRS;
+				double scale = 0.25 + numbers.uniform() * (1.0 / 3 - 0.25);
+				children[2 * k] = snowflake::translate(0, distance) * snowflake::rotate(PI / 3) * snowflake::scale(scale);
+				children[2 * k + 1] = snowflake::translate(0, distance) * snowflake::rotate(-PI / 3) * snowflake::scale(scale);
+			}
+		});
+	}
+	cout << "  products for each line: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	start = bench_clock::now();
+	snowflake::rule_set rules = snowflake::rule_set::branching(PAIRS, 0.25, 1.0 / 3, PI / 3, SEED);
+	snowflake::generator ruled(seed, rules.child_count(), LEVELS);
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		ruled.grow(rules);
+	}
+	cout << "  rule set: " << elapsed_ns(start) / 1e6 << " ms" << endl;
+	double maxdiff = 0;
+	for(size_t i = 0; i < ruled.lines().size(); i++) {
+		const double* a = ruled.lines()[i].transformation.data();
+		const double* b = products.lines()[i].transformation.data();
+		for(size_t j = 0; j < 6; j++) {
+			maxdiff = max(maxdiff, fabs(a[j] - b[j]));
+		}
+	}
+	cout << "  (" << ruled.lines().size() << " lines, largest difference " << maxdiff << ")" << endl;
+}
+
+/**
+ * Time rule sets with parameters given at run time and
+ * fixed at compile time.
+ */
+void bench_static_rules() {
+	const unsigned int LEVELS = 9;
+	const unsigned int KOCH_LEVELS = 7;
+	const uint64_t SEED = 1;
+	//Each path is timed several times, keeping the fastest,
+	//so neither pays for first touching its memory
+	const int REPEATS = 5;
+	bench_clock::time_point start;
+	snowflake::line seed(snowflake::scale(240));
+
+	cout << "Rule sets fixed at run time and at compile time (fastest of " << REPEATS << "):" << endl;
+	snowflake::rule_set rules = snowflake::rule_set::branching(bench_branching::PAIRS, bench_branching::MIN_SCALE, bench_branching::MAX_SCALE, bench_branching::ANGLE, SEED);
+	snowflake::basic_static_branching<double, bench_branching> static_rules(SEED);
+	snowflake::generator runtime(seed, rules.child_count(), 0);
+	snowflake::generator compiled(seed, static_rules.CHILD_COUNT, 0);
+	double runtime_ns = 0;
+	double compiled_ns = 0;
+	for(int r = 0; r < REPEATS; r++) {
+		start = bench_clock::now();
+		runtime = snowflake::generator(seed, rules.child_count(), LEVELS);
+		for(unsigned int i = 0; i < LEVELS; i++) {
+			runtime.grow(rules);
+		}
+		double ns = elapsed_ns(start);
+		runtime_ns = (r == 0) ? ns : min(runtime_ns, ns);
+		start = bench_clock::now();
+		compiled = snowflake::generator(seed, static_rules.CHILD_COUNT, LEVELS);
+		for(unsigned int i = 0; i < LEVELS; i++) {
+			compiled.grow_static(static_rules);
+		}
+		ns = elapsed_ns(start);
+		compiled_ns = (r == 0) ? ns : min(compiled_ns, ns);
+	}
+	cout << "  " << LEVELS << " random levels, run time: " << runtime_ns / 1e6 << " ms" << endl;
+	cout << "  " << LEVELS << " random levels, compile time: " << compiled_ns / 1e6 << " ms" << endl;
+	double maxdiff = 0;
+	for(size_t i = 0; i < runtime.lines().size(); i++) {
+		const double* a = runtime.lines()[i].transformation.data();
+		const double* b = compiled.lines()[i].transformation.data();
+		for(size_t j = 0; j < 6; j++) {
+			maxdiff = max(maxdiff, fabs(a[j] - b[j]));
+		}
+	}
+	cout << "  (largest difference " << maxdiff << ")" << endl;
+
+	snowflake::rule_set koch = snowflake::rule_set::koch();
+	vector<snowflake::line> lines;
+	vector<snowflake::line> newlines;
+	runtime_ns = 0;
+	compiled_ns = 0;
+	double checksum = 0;
+	for(int r = 0; r < REPEATS; r++) {
+		lines.assign(1, seed);
+		start = bench_clock::now();
+		for(unsigned int i = 0; i < KOCH_LEVELS; i++) {
+			newlines.resize(lines.size() * 7);
+			snowflake::expand(&lines[0], lines.size(), koch.table(), koch.child_count(), &newlines[0]);
+			lines.swap(newlines);
+		}
+		double ns = elapsed_ns(start);
+		runtime_ns = (r == 0) ? ns : min(runtime_ns, ns);
+		checksum = lines.back().transformation(0, 2);
+		lines.assign(1, seed);
+		start = bench_clock::now();
+		for(unsigned int i = 0; i < KOCH_LEVELS; i++) {
+			newlines.resize(lines.size() * 7);
+			snowflake::expand_static<7>(&lines[0], lines.size(), koch.table(), &newlines[0]);
+			lines.swap(newlines);
+		}
+		ns = elapsed_ns(start);
+		compiled_ns = (r == 0) ? ns : min(compiled_ns, ns);
+	}
+	cout << "  " << KOCH_LEVELS << " nonrandom levels, run time: " << runtime_ns / 1e6 << " ms" << endl;
+	cout << "  " << KOCH_LEVELS << " nonrandom levels, compile time: " << compiled_ns / 1e6 << " ms" << endl;
+	if(checksum != lines.back().transformation(0, 2)) {
+		cout << "  nonrandom lines differ" << endl;
+	}
+}
+
+/**
+ * Time growing a random spoke drawn at 8K to a depth
+ * guessed to reach lines under a pixel, and only
+ * until its lines are under a pixel.
+ */
+void bench_adaptive() {
+	const unsigned int LEVELS = 7;
+	const unsigned int MAX_LEVELS = 32;
+	const double MIN_LENGTH = 1;
+	const size_t BATCH_SIZE = 4096;
+	const uint64_t SEED = 1;
+	bench_clock::time_point start;
+	//Same size in a window 4320 pixels high as
+	//the main program's spoke in 500
+	snowflake::line seed(snowflake::scale(240 * 4320 / 500));
+
+	cout << "Growing a random spoke at 8K to a fixed depth and to " << MIN_LENGTH << " pixel lines:" << endl;
+	snowflake::basic_static_branching<double, bench_branching> rules(SEED);
+	start = bench_clock::now();
+	snowflake::generator fixed(seed, rules.CHILD_COUNT, LEVELS);
+	for(unsigned int i = 0; i < LEVELS; i++) {
+		fixed.grow_static(rules);
+	}
+	cout << "  " << LEVELS << " levels: " << elapsed_ns(start) / 1e6 << " ms, " << fixed.lines().size() << " lines" << endl;
+	start = bench_clock::now();
+	snowflake::generator adaptive(seed, rules.CHILD_COUNT, MAX_LEVELS, MIN_LENGTH);
+	for(unsigned int i = 0; i < MAX_LEVELS; i++) {
+		adaptive.grow_static(rules);
+		if(adaptive.level_begin(i + 1) == adaptive.level_end(i + 1)) {
+			break;
+		}
+	}
+	//The last level grown is empty
+	cout << "  adaptive: " << elapsed_ns(start) / 1e6 << " ms, " << adaptive.lines().size() << " lines, "
+		<< adaptive.level_count() - 2 << " levels" << endl;
+
+	snowflake::rule_set rule_set = snowflake::rule_set::branching(bench_branching::PAIRS, bench_branching::MIN_SCALE, bench_branching::MAX_SCALE, bench_branching::ANGLE, SEED);
+	vector<snowflake::line> batch(BATCH_SIZE);
+	size_t count;
+	size_t total = 0;
+	start = bench_clock::now();
+	snowflake::walker fixed_walker(&seed, 1, rule_set, LEVELS);
+	while((count = fixed_walker.next_batch(&batch[0], BATCH_SIZE)) > 0) {
+		total += count;
+	}
+	cout << "  walking " << LEVELS << " levels: " << elapsed_ns(start) / 1e6 << " ms, " << total << " leaves" << endl;
+	total = 0;
+	start = bench_clock::now();
+	snowflake::walker adaptive_walker(&seed, 1, rule_set, MAX_LEVELS, MIN_LENGTH);
+	while((count = adaptive_walker.next_batch(&batch[0], BATCH_SIZE)) > 0) {
+		total += count;
+	}
+	cout << "  walking adaptively: " << elapsed_ns(start) / 1e6 << " ms, " << total << " leaves" << endl;
+}
+
+int main() {
+	bench_child_transform();
+	bench_gemm();
+	bench_lu();
+	bench_solve();
+	bench_power();
+	bench_structure();
+	bench_views();
+	bench_points();
+	bench_expand();
+	bench_float();
+	bench_allocations();
+	bench_copy_on_write();
+	bench_access();
+	bench_parallel();
+	bench_io();
+	bench_generate();
+	bench_parallel_generate();
+	bench_rng();
+	bench_walk();
+	bench_symmetry();
+	bench_rules();
+	bench_static_rules();
+	bench_adaptive();
+	return 0;
+}
@@ -0,0 +1,168 @@
+#include "affine.h"
+#include "matrix.h"
+#include <cstddef>
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+using std::size_t;
+using std::invalid_argument;
+using std::out_of_range;
+using std::ostream;
+using std::copy;
+
+namespace lapiday {
+	namespace matrix {
+		template<class T>
+		basic_affine<T>::basic_affine() {
+			_entries[0] = 1;
+			_entries[1] = 0;
+			_entries[2] = 0;
+			_entries[3] = 0;
+			_entries[4] = 1;
+			_entries[5] = 0;
+		}
+
+		template<class T>
+		basic_affine<T>::basic_affine(T a, T b, T c, T d, T e, T f) {
+			_entries[0] = a;
+			_entries[1] = b;
+			_entries[2] = c;
+			_entries[3] = d;
+			_entries[4] = e;
+			_entries[5] = f;
+		}
+
+		template<class T>
+		basic_affine<T>::basic_affine(const basic_matrix<T>& m) {
+			if((m.rows() != 3) || (m.cols() != 3)) {
+				throw invalid_argument("Matrix is not 3-by-3");
+			}
+			if((m(2, 0) != 0) || (m(2, 1) != 0) || (m(2, 2) != 1)) {
+				throw invalid_argument("Matrix is not affine");
+			}
+			for(size_t i = 0; i < 2; i++) {
+				for(size_t j = 0; j < 3; j++) {
+					_entries[3 * i + j] = m.unchecked(i, j);
+				}
+			}
+		}
+
+		template<class T>
+		basic_matrix<T> basic_affine<T>::to_matrix() const {
+			//Identity already has the last row
+			basic_matrix<T> temp(3);
+			copy(_entries, _entries + 6, temp.data());
+			//Tag the matrix (at least affine) for faster products
+			temp.detect_structure();
+			return temp;
+		}
+
+		template<class T>
+		void basic_affine<T>::apply(T x, T y, T& outx, T& outy) const {
+			outx = _entries[0] * x + _entries[1] * y + _entries[2];
+			outy = _entries[3] * x + _entries[4] * y + _entries[5];
+		}
+
+		template<class T>
+		T& basic_affine<T>::operator()(size_t i, size_t j) {
+			if((i < 2) && (j < 3)) {
+				return _entries[3 * i + j];
+			} else {
+				throw out_of_range("Element index out of range");
+			}
+		}
+
+		template<class T>
+		T basic_affine<T>::operator()(size_t i, size_t j) const {
+			if((i < 2) && (j < 3)) {
+				return _entries[3 * i + j];
+			} else if((i == 2) && (j < 3)) {
+				//Implicit last row
+				return (j == 2) ? 1 : 0;
+			} else {
+				throw out_of_range("Element index out of range");
+			}
+		}
+
+		template<class T>
+		bool basic_affine<T>::_equals(const basic_affine<T>& t) const {
+			for(size_t i = 0; i < 6; i++) {
+				if(_entries[i] != t._entries[i]) {
+					return false;
+				}
+			}
+			//Did not return in loop
+			return true;
+		}
+
+		template<class T>
+		basic_affine<T> basic_affine<T>::_compose(const basic_affine<T>& t) const {
+			const T* l = _entries;
+			const T* r = t._entries;
+			//The last row of each factor is (0, 0, 1),
+			//so only the first two rows need computing
+			return basic_affine<T>(
+				l[0] * r[0] + l[1] * r[3],
+				l[0] * r[1] + l[1] * r[4],
+				l[0] * r[2] + l[1] * r[5] + l[2],
+				l[3] * r[0] + l[4] * r[3],
+				l[3] * r[1] + l[4] * r[4],
+				l[3] * r[2] + l[4] * r[5] + l[5]
+			);
+		}
+
+		template<class T>
+		basic_affine<T>& basic_affine<T>::operator *=(const basic_affine<T>& t) {
+			*this = *this * t;
+			return *this;
+		}
+
+		template<class T>
+		basic_matrix<T> basic_affine<T>::_multiply(const basic_matrix<T>& m) const {
+			if(m.rows() != 3) {
+				throw invalid_argument("Matrices cannot be multiplied in the given order");
+			}
+			basic_matrix<T> temp(3, m.cols());
+			for(size_t j = 0; j < m.cols(); j++) {
+				for(size_t i = 0; i < 2; i++) {
+					temp.unchecked(i, j) = _entries[3 * i] * m.unchecked(0, j)
+						+ _entries[3 * i + 1] * m.unchecked(1, j)
+						+ _entries[3 * i + 2] * m.unchecked(2, j);
+				}
+				temp.unchecked(2, j) = m.unchecked(2, j);
+			}
+			return temp;
+		}
+
+		template<class T>
+		void basic_affine<T>::_transform_points(const T* x, const T* y, T* outx, T* outy, size_t count) const {
+			//Copy the entries so the loop does not reload
+			//them after each store, and can be vectorized
+			T a = _entries[0];
+			T b = _entries[1];
+			T c = _entries[2];
+			T d = _entries[3];
+			T e = _entries[4];
+			T f = _entries[5];
+			for(size_t i = 0; i < count; i++) {
+				T px = x[i];
+				T py = y[i];
+				outx[i] = a * px + b * py + c;
+				outy[i] = d * px + e * py + f;
+			}
+		}
+
+		template<class T>
+		void basic_affine<T>::_transform_point(const basic_affine<T>* transforms, size_t count, T x, T y, T* outx, T* outy) {
+			for(size_t i = 0; i < count; i++) {
+				const T* m = transforms[i]._entries;
+				outx[i] = m[0] * x + m[1] * y + m[2];
+				outy[i] = m[3] * x + m[4] * y + m[5];
+			}
+		}
+
+		template class basic_affine<float>;
+		template class basic_affine<double>;
+	}
+}
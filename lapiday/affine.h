@@ -0,0 +1,289 @@
+#ifndef LAPIDAY_AFFINE_H
+#define LAPIDAY_AFFINE_H
+
+#include "matrix.h"
+#include <cstddef>
+#include <stdexcept>
+#include <iostream>
+
+using std::size_t;
+using std::invalid_argument;
+using std::out_of_range;
+using std::ostream;
+
+namespace lapiday {
+	namespace matrix {
+		/**
+		* Two-dimensional affine transformation,
+		* equivalent to a 3-by-3 matrix whose last
+		* row is (0, 0, 1). Only the first two rows
+		* are stored, so the object has a fixed size
+		* and never allocates. Only float and double
+		* entries are supported; affine is the double
+		* version.
+		*/
+		template<class T>
+		class basic_affine {
+		public:
+			/**
+			* Create a new identity transformation.
+			*/
+			basic_affine();
+
+			/**
+			* Create a new transformation with the given
+			* entries of the first two rows.
+			* @param a Entry (0, 0)
+			* @param b Entry (0, 1)
+			* @param c Entry (0, 2)
+			* @param d Entry (1, 0)
+			* @param e Entry (1, 1)
+			* @param f Entry (1, 2)
+			*/
+			basic_affine(T a, T b, T c, T d, T e, T f);
+
+			/**
+			* Create a new transformation equal to the
+			* given matrix.
+			* @param m Original matrix
+			* @throw invalid_argument If the matrix is not
+			* 3-by-3, or if its last row is not (0, 0, 1)
+			*/
+			explicit basic_affine(const basic_matrix<T>& m);
+
+			/**
+			* Create a new transformation with the entries
+			* of a transformation of another scalar type,
+			* converted to this type.
+			* @param t Original transformation
+			*/
+			template<class U>
+			explicit basic_affine(const basic_affine<U>& t);
+
+			/**
+			* Get the equivalent 3-by-3 matrix, with its
+			* structure detected.
+			* @return Matrix
+			*/
+			basic_matrix<T> to_matrix() const;
+
+			/**@{*/
+			/**
+			* Get the entries of the first two rows, in
+			* row-major order, for reading or writing in bulk.
+			* These are defined inline so that loops over
+			* many transformations do not call a function
+			* for every element.
+			* @return Array of 6 entries
+			*/
+			const T* data() const;
+			T* data();
+			/**@}*/
+
+			/**
+			* Apply this transformation to a point.
+			* @param x x-coordinate of the point
+			* @param y y-coordinate of the point
+			* @param outx Set to the transformed x-coordinate
+			* @param outy Set to the transformed y-coordinate
+			*/
+			void apply(T x, T y, T& outx, T& outy) const;
+
+			/**@{*/
+			/**
+			* Get the entry at the given position of the
+			* equivalent 3-by-3 matrix. The last row
+			* is implicit, so it can be read but not written.
+			* @param i Row (zero-based)
+			* @param j Column (zero-based)
+			* @return Entry
+			* @throw out_of_range If the row or column
+			* is not in the range of this transformation
+			*/
+			T& operator()(size_t i, size_t j);
+			T operator()(size_t i, size_t j) const;
+			/**@}*/
+
+			/**
+			* Check if the two transformations are equal.
+			* @param first First transformation
+			* @param second Second transformation
+			* @return true if the transformations are equal,
+			* false otherwise
+			*/
+			friend bool operator ==(const basic_affine& first, const basic_affine& second) {
+				return first._equals(second);
+			}
+
+			/**
+			* Check if the two transformations are not equal.
+			* @param first First transformation
+			* @param second Second transformation
+			* @return true if the transformations are not equal,
+			* false otherwise
+			*/
+			friend bool operator !=(const basic_affine& first, const basic_affine& second) {
+				return !first._equals(second);
+			}
+
+			/**
+			* Compose two transformations (multiply their
+			* matrices).
+			* @param first First factor
+			* @param second Second factor
+			* @return Product
+			*/
+			friend basic_affine operator *(const basic_affine& first, const basic_affine& second) {
+				return first._compose(second);
+			}
+
+			/**
+			* Multiply this transformation by another
+			* transformation.
+			* @param t Transformation to multiply by
+			* @return This transformation
+			*/
+			basic_affine& operator *=(const basic_affine& t);
+
+			/**@{*/
+			/**
+			* Multiply a transformation and a matrix, treating
+			* the transformation as a 3-by-3 matrix.
+			* @param t Transformation
+			* @param m Matrix
+			* @return Product
+			* @throw invalid_argument If the matrices cannot
+			* be multiplied in this order
+			*/
+			friend basic_matrix<T> operator *(const basic_affine& t, const basic_matrix<T>& m) {
+				return t._multiply(m);
+			}
+
+			friend basic_matrix<T> operator *(const basic_matrix<T>& m, const basic_affine& t) {
+				return m * t.to_matrix();
+			}
+			/**@}*/
+
+			/**
+			* Output this transformation to the stream,
+			* in the same format as a matrix.
+			* @param out Stream to output to
+			* @param t Transformation to output
+			* @return The stream
+			*/
+			friend ostream& operator <<(ostream& out, const basic_affine& t) {
+				return out << t.to_matrix();
+			}
+
+			/**
+			* Apply one transformation to many points, stored
+			* as separate arrays of coordinates. The output
+			* arrays may be the same as the input arrays.
+			* @param t Transformation
+			* @param x x-coordinates of the points
+			* @param y y-coordinates of the points
+			* @param outx Array for the transformed x-coordinates
+			* @param outy Array for the transformed y-coordinates
+			* @param count Number of points
+			*/
+			friend void transform_points(const basic_affine& t, const T* x, const T* y, T* outx, T* outy, size_t count) {
+				t._transform_points(x, y, outx, outy, count);
+			}
+
+			/**
+			* Apply many transformations to one point.
+			* @param transforms Transformations
+			* @param count Number of transformations
+			* @param x x-coordinate of the point
+			* @param y y-coordinate of the point
+			* @param outx Array for the transformed x-coordinates,
+			* one per transformation
+			* @param outy Array for the transformed y-coordinates,
+			* one per transformation
+			*/
+			friend void transform_point(const basic_affine* transforms, size_t count, T x, T y, T* outx, T* outy) {
+				_transform_point(transforms, count, x, y, outx, outy);
+			}
+		private:
+			/**
+			* Entries of the first two rows, in row-major order
+			*/
+			T _entries[6];
+
+			/**
+			* Check if this transformation is equal to
+			* another transformation.
+			* @param t Transformation to compare with
+			* @return true if the transformations are equal,
+			* false otherwise
+			*/
+			bool _equals(const basic_affine& t) const;
+
+			/**
+			* Compose this transformation with another
+			* transformation (this one on the left).
+			* @param t Second factor
+			* @return Product
+			*/
+			basic_affine _compose(const basic_affine& t) const;
+
+			/**
+			* Multiply this transformation by a matrix
+			* on the right, treating the transformation
+			* as a 3-by-3 matrix.
+			* @param m Matrix
+			* @return Product
+			* @throw invalid_argument If the matrices cannot
+			* be multiplied in this order
+			*/
+			basic_matrix<T> _multiply(const basic_matrix<T>& m) const;
+
+			/**
+			* Apply this transformation to many points.
+			* @param x x-coordinates of the points
+			* @param y y-coordinates of the points
+			* @param outx Array for the transformed x-coordinates
+			* @param outy Array for the transformed y-coordinates
+			* @param count Number of points
+			*/
+			void _transform_points(const T* x, const T* y, T* outx, T* outy, size_t count) const;
+
+			/**
+			* Apply many transformations to one point.
+			* @param transforms Transformations
+			* @param count Number of transformations
+			* @param x x-coordinate of the point
+			* @param y y-coordinate of the point
+			* @param outx Array for the transformed x-coordinates
+			* @param outy Array for the transformed y-coordinates
+			*/
+			static void _transform_point(const basic_affine* transforms, size_t count, T x, T y, T* outx, T* outy);
+		};
+
+		/**
+		* Affine transformation with double entries
+		*/
+		typedef basic_affine<double> affine;
+
+		template<class T>
+		template<class U>
+		basic_affine<T>::basic_affine(const basic_affine<U>& t) {
+			const U* entries = t.data();
+			for(size_t i = 0; i < 6; i++) {
+				_entries[i] = static_cast<T>(entries[i]);
+			}
+		}
+
+		template<class T>
+		inline const T* basic_affine<T>::data() const {
+			return _entries;
+		}
+
+		template<class T>
+		inline T* basic_affine<T>::data() {
+			return _entries;
+		}
+	}
+}
+
+#endif
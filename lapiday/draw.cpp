@@ -1,59 +1,164 @@
 #include "draw.h"
 #include "constants.h"
 #include <cmath>
+#include <vector>
+#include <cstddef>
 
 //using std::acos;
 using std::sqrt;
 //using std::fabs;
+using std::vector;
+using std::size_t;
 
 namespace lapiday {
-	void draw_line(sf::RenderTarget& target, const snowflake::line& line, int height) {
-		matrix::matrix base(3, 2);
-		base(0, 0) = 0;
-		base(0, 1) = 0;
-		base(1, 0) = 0;
-		base(1, 1) = 1;
-		base(2, 0) = 1;
-		base(2, 1) = 1;
-		matrix::matrix endpoints = line.transformation * base;
+	/**
+	 * Number of points in the pentagon
+	 * drawn for each line (the origin is
+	 * an extra point)
+	 */
+	static const size_t PENTAGON_POINTS = 6;
+
+	/**
+	 * Find the points of the pentagon drawn
+	 * for a line, before the line's transformation.
+	 * @param normscale Half the pentagon width,
+	 * relative to the length of the line
+	 * @param x Array for the x-coordinates
+	 * @param y Array for the y-coordinates
+	 */
+	template<class T>
+	static void pentagon_base(T normscale, T* x, T* y) {
+		//Ends of the base line rotated by PI / 2
+		//and scaled by normscale
+		x[0] = -normscale;
+		y[0] = 0;
+		x[1] = 0;
+		y[1] = 0;
+		//Ends of the base line scaled by
+		//(1 - normscale) and translated by normscale
+		x[2] = normscale;
+		y[2] = 0;
+		x[3] = normscale;
+		y[3] = 1 - normscale;
+		//Ends of the base line scaled by
+		//ROOT_TWO * normscale, rotated by PI * 3 / 4,
+		//and translated to the tip
+		x[4] = 0;
+		y[4] = 1;
+		x[5] = -normscale;
+		y[5] = 1 - normscale;
+	}
+
+	/**
+	 * Get the scale that makes a line segment
+	 * as long as half the pentagon width.
+	 * @param x Difference between the x-coordinates
+	 * of the endpoints
+	 * @param y Difference between the y-coordinates
+	 * of the endpoints
+	 * @return Scale
+	 */
+	template<class T>
+	static T pentagon_scale(T x, T y) {
+		return 0.5 * PENTAGON_WIDTH / sqrt(x * x + y * y);
+	}
+
+	/**
+	 * Draw the pentagon with the given points.
+	 * @param target Target to draw to
+	 * @param x x-coordinates of the points
+	 * @param y y-coordinates of the points
+	 * @param height Height of the target
+	 */
+	template<class T>
+	static void draw_pentagon(sf::RenderTarget& target, const T* x, const T* y, int height) {
+		sf::ConvexShape temp(PENTAGON_POINTS);
+		for(size_t i = 0; i < PENTAGON_POINTS; i++) {
+			temp.setPoint(i, sf::Vector2f(x[i], height - y[i]));
+		}
+		temp.setFillColor(FOREGROUND_COLOR);
+		target.draw(temp);
+	}
+
+	template<class T>
+	void draw_line(sf::RenderTarget& target, const snowflake::basic_line<T>& line, int height) {
+		T x0, y0, x1, y1;
+		line.transformation.apply(0, 0, x0, y0);
+		line.transformation.apply(0, 1, x1, y1);
 		/*
 		//Offset-polygon rendering
 		sf::ConvexShape temp(4);
-		temp.setPoint(0, sf::Vector2f(endpoints(0, 0), height - endpoints(1, 0)));
-		temp.setPoint(1, sf::Vector2f(endpoints(0, 1), height - endpoints(1, 1)));
-		temp.setPoint(2, sf::Vector2f(endpoints(0, 0) + LINE_OFFSET, height - endpoints(1, 0) + LINE_OFFSET));
-		temp.setPoint(3, sf::Vector2f(endpoints(0, 1) + LINE_OFFSET, height - endpoints(1, 1) + LINE_OFFSET));
+		temp.setPoint(0, sf::Vector2f(x0, height - y0));
+		temp.setPoint(1, sf::Vector2f(x1, height - y1));
+		temp.setPoint(2, sf::Vector2f(x0 + LINE_OFFSET, height - y0 + LINE_OFFSET));
+		temp.setPoint(3, sf::Vector2f(x1 + LINE_OFFSET, height - y1 + LINE_OFFSET));
 		temp.setFillColor(FOREGROUND_COLOR);
 		target.draw(temp);
 		*/
 		/*
 		//Line-primitive rendering
 		sf::Vertex temp[2];
-		temp[0] = sf::Vertex(sf::Vector2f(endpoints(0, 0), height - endpoints(1, 0)), FOREGROUND_COLOR);
-		temp[1] = sf::Vertex(sf::Vector2f(endpoints(0, 1), height - endpoints(1, 1)), FOREGROUND_COLOR);
+		temp[0] = sf::Vertex(sf::Vector2f(x0, height - y0), FOREGROUND_COLOR);
+		temp[1] = sf::Vertex(sf::Vector2f(x1, height - y1), FOREGROUND_COLOR);
 		target.draw(temp, 2, sf::Lines);
 		*/
 
 		//Pentagon rendering
-		//The origin is an extra point
-		sf::ConvexShape temp(6);
-		double x = endpoints(0, 1) - endpoints(0, 0);
-		double y = endpoints(1, 1) - endpoints(1, 0);
-		//Scale that yields a line segment as long as half the width
-		double normscale = 0.5 * PENTAGON_WIDTH / sqrt(x * x + y * y);
-		//double normscale = 1;
-		matrix::matrix segment;
-		segment = line.transformation * snowflake::rotate(PI / 2) * snowflake::scale(normscale) * base;
-		temp.setPoint(0, sf::Vector2f(segment(0, 1), height - segment(1, 1)));
-		temp.setPoint(1, sf::Vector2f(segment(0, 0), height - segment(1, 0)));
-		segment = line.transformation * snowflake::translate(normscale, 0) * snowflake::scale(1 - normscale) * base;
-		temp.setPoint(2, sf::Vector2f(segment(0, 0), height - segment(1, 0)));
-		temp.setPoint(3, sf::Vector2f(segment(0, 1), height - segment(1, 1)));
-		segment = line.transformation * snowflake::translate(0, 1) * snowflake::rotate(PI * 3 / 4) * snowflake::scale(ROOT_TWO * normscale) * base;
-		temp.setPoint(4, sf::Vector2f(segment(0, 0), height - segment(1, 0)));
-		temp.setPoint(5, sf::Vector2f(segment(0, 1), height - segment(1, 1)));
-		temp.setFillColor(FOREGROUND_COLOR);
-		target.draw(temp);
+		T x[PENTAGON_POINTS];
+		T y[PENTAGON_POINTS];
+		pentagon_base(pentagon_scale(x1 - x0, y1 - y0), x, y);
+		for(size_t i = 0; i < PENTAGON_POINTS; i++) {
+			line.transformation.apply(x[i], y[i], x[i], y[i]);
+		}
+		draw_pentagon(target, x, y, height);
+	}
+
+	template<class T>
+	void draw_lines(sf::RenderTarget& target, const vector<snowflake::basic_line<T> >& lines, const matrix::affine& view, int height) {
+		size_t count = lines.size();
+		if(count == 0) {
+			return;
+		}
+		const matrix::basic_affine<T> target_view(view);
+		//Endpoints as they appear on the target
+		vector<T> x0(count);
+		vector<T> y0(count);
+		vector<T> x1(count);
+		vector<T> y1(count);
+		snowflake::endpoints(&lines[0], count, &x0[0], &y0[0], &x1[0], &y1[0]);
+		transform_points(target_view, &x0[0], &y0[0], &x0[0], &y0[0], count);
+		transform_points(target_view, &x1[0], &y1[0], &x1[0], &y1[0], count);
 
+		//Pentagon rendering
+		vector<T> x(count * PENTAGON_POINTS);
+		vector<T> y(count * PENTAGON_POINTS);
+		for(size_t i = 0; i < count; i++) {
+			T* px = &x[i * PENTAGON_POINTS];
+			T* py = &y[i * PENTAGON_POINTS];
+			pentagon_base(pentagon_scale(x1[i] - x0[i], y1[i] - y0[i]), px, py);
+			for(size_t j = 0; j < PENTAGON_POINTS; j++) {
+				lines[i].transformation.apply(px[j], py[j], px[j], py[j]);
+			}
+		}
+		transform_points(target_view, &x[0], &y[0], &x[0], &y[0], x.size());
+		for(size_t i = 0; i < count; i++) {
+			draw_pentagon(target, &x[i * PENTAGON_POINTS], &y[i * PENTAGON_POINTS], height);
+		}
 	}
-}
\ No newline at end of file
+
+	template<class T>
+	void draw_lines(sf::RenderTarget& target, const vector<snowflake::basic_line<T> >& lines, const vector<matrix::affine>& instances, const matrix::affine& view, int height) {
+		for(size_t i = 0; i < instances.size(); i++) {
+			draw_lines(target, lines, view * instances[i], height);
+		}
+	}
+
+	template void draw_line(sf::RenderTarget& target, const snowflake::basic_line<float>& line, int height);
+	template void draw_line(sf::RenderTarget& target, const snowflake::basic_line<double>& line, int height);
+
+	template void draw_lines(sf::RenderTarget& target, const vector<snowflake::basic_line<float> >& lines, const matrix::affine& view, int height);
+	template void draw_lines(sf::RenderTarget& target, const vector<snowflake::basic_line<double> >& lines, const matrix::affine& view, int height);
+
+	template void draw_lines(sf::RenderTarget& target, const vector<snowflake::basic_line<float> >& lines, const vector<matrix::affine>& instances, const matrix::affine& view, int height);
+	template void draw_lines(sf::RenderTarget& target, const vector<snowflake::basic_line<double> >& lines, const vector<matrix::affine>& instances, const matrix::affine& view, int height);
+}
@@ -3,6 +3,8 @@
 
 #include "matrix.h"
 #include "snowflake.h"
+#include "affine.h"
+#include <vector>
 #include <SFML/Graphics.hpp>
 
 namespace lapiday {
@@ -12,7 +14,43 @@ namespace lapiday {
 	 * @param line Line to draw
 	 * @param height Height of the target
 	 */
-	void draw_line(sf::RenderTarget& target, const snowflake::line& line, int height);
+	template<class T>
+	void draw_line(sf::RenderTarget& target, const snowflake::basic_line<T>& line, int height);
+
+	/**
+	 * Draw many lines to the target,
+	 * transforming all their points in bulk.
+	 * Points are computed with the scalar
+	 * type of the lines.
+	 * @param target Target to draw to
+	 * @param lines Lines to draw
+	 * @param view Transformation applied to
+	 * every point after the line's own
+	 * transformation (for example, to move
+	 * the origin to the center of the target)
+	 * @param height Height of the target
+	 */
+	template<class T>
+	void draw_lines(sf::RenderTarget& target, const std::vector<snowflake::basic_line<T> >& lines, const matrix::affine& view, int height);
+
+	/**
+	 * Draw many lines to the target once
+	 * for each instance transformation,
+	 * without storing the copies (for
+	 * example, to draw every spoke of
+	 * a snowflake from one spoke).
+	 * @param target Target to draw to
+	 * @param lines Lines to draw
+	 * @param instances Transformations
+	 * applied to every line, one copy each
+	 * (see snowflake::symmetry())
+	 * @param view Transformation applied to
+	 * every point after the instance
+	 * transformation
+	 * @param height Height of the target
+	 */
+	template<class T>
+	void draw_lines(sf::RenderTarget& target, const std::vector<snowflake::basic_line<T> >& lines, const std::vector<matrix::affine>& instances, const matrix::affine& view, int height);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,487 @@
+#include "gemm.h"
+#include "parallel.h"
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LAPIDAY_GEMM_X86
+#include <immintrin.h>
+#endif
+
+using std::size_t;
+using std::fill;
+using std::min;
+using std::vector;
+
+namespace lapiday {
+	namespace gemm {
+		/**
+		 * Block sizes, chosen so a block of the second
+		 * factor (INNER_BLOCK by COL_BLOCK) fits in L2 cache
+		 * and a block of the first factor (ROW_BLOCK by
+		 * INNER_BLOCK) fits in L1 cache
+		 */
+		const size_t ROW_BLOCK = 64;
+		const size_t INNER_BLOCK = 128;
+		const size_t COL_BLOCK = 256;
+
+		/**
+		 * Kernel that adds the product of two blocks
+		 * to a block of the output (the type member).
+		 * @param first First factor block
+		 * @param second Second factor block
+		 * @param out Output block
+		 * @param rows Number of rows in the block
+		 * @param inner Inner dimension of the block
+		 * @param cols Number of columns in the block
+		 * @param first_stride Distance between rows of
+		 * the first factor
+		 * @param second_stride Distance between rows of
+		 * the second factor
+		 * @param out_stride Distance between rows of
+		 * the output
+		 */
+		template<class T>
+		struct block_kernel {
+			typedef void (*type)(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols, size_t first_stride, size_t second_stride, size_t out_stride);
+		};
+
+		template<class T>
+		static void block_generic(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols, size_t first_stride, size_t second_stride, size_t out_stride) {
+			for(size_t i = 0; i < rows; i++) {
+				T* outrow = out + i * out_stride;
+				for(size_t k = 0; k < inner; k++) {
+					T a = first[i * first_stride + k];
+					const T* secondrow = second + k * second_stride;
+					for(size_t j = 0; j < cols; j++) {
+						outrow[j] += a * secondrow[j];
+					}
+				}
+			}
+		}
+
+#ifdef __SSE2__
+		static void block_sse2(const double* first, const double* second, double* out, size_t rows, size_t inner, size_t cols, size_t first_stride, size_t second_stride, size_t out_stride) {
+			size_t i = 0;
+			//Tiles of 4 rows by 4 columns, held in registers
+			for(; i + 4 <= rows; i += 4) {
+				size_t j = 0;
+				for(; j + 4 <= cols; j += 4) {
+					double* c = out + i * out_stride + j;
+					__m128d c00 = _mm_loadu_pd(c);
+					__m128d c01 = _mm_loadu_pd(c + 2);
+					__m128d c10 = _mm_loadu_pd(c + out_stride);
+					__m128d c11 = _mm_loadu_pd(c + out_stride + 2);
+					__m128d c20 = _mm_loadu_pd(c + 2 * out_stride);
+					__m128d c21 = _mm_loadu_pd(c + 2 * out_stride + 2);
+					__m128d c30 = _mm_loadu_pd(c + 3 * out_stride);
+					__m128d c31 = _mm_loadu_pd(c + 3 * out_stride + 2);
+					const double* a = first + i * first_stride;
+					for(size_t k = 0; k < inner; k++) {
+						const double* b = second + k * second_stride + j;
+						__m128d b0 = _mm_loadu_pd(b);
+						__m128d b1 = _mm_loadu_pd(b + 2);
+						__m128d a0 = _mm_set1_pd(a[k]);
+						__m128d a1 = _mm_set1_pd(a[first_stride + k]);
+						__m128d a2 = _mm_set1_pd(a[2 * first_stride + k]);
+						__m128d a3 = _mm_set1_pd(a[3 * first_stride + k]);
+						c00 = _mm_add_pd(c00, _mm_mul_pd(a0, b0));
+						c01 = _mm_add_pd(c01, _mm_mul_pd(a0, b1));
+						c10 = _mm_add_pd(c10, _mm_mul_pd(a1, b0));
+						c11 = _mm_add_pd(c11, _mm_mul_pd(a1, b1));
+						c20 = _mm_add_pd(c20, _mm_mul_pd(a2, b0));
+						c21 = _mm_add_pd(c21, _mm_mul_pd(a2, b1));
+						c30 = _mm_add_pd(c30, _mm_mul_pd(a3, b0));
+						c31 = _mm_add_pd(c31, _mm_mul_pd(a3, b1));
+					}
+					_mm_storeu_pd(c, c00);
+					_mm_storeu_pd(c + 2, c01);
+					_mm_storeu_pd(c + out_stride, c10);
+					_mm_storeu_pd(c + out_stride + 2, c11);
+					_mm_storeu_pd(c + 2 * out_stride, c20);
+					_mm_storeu_pd(c + 2 * out_stride + 2, c21);
+					_mm_storeu_pd(c + 3 * out_stride, c30);
+					_mm_storeu_pd(c + 3 * out_stride + 2, c31);
+				}
+				//Leftover columns
+				block_generic(first + i * first_stride, second + j, out + i * out_stride + j, 4, inner, cols - j, first_stride, second_stride, out_stride);
+			}
+			//Leftover rows
+			block_generic(first + i * first_stride, second, out + i * out_stride, rows - i, inner, cols, first_stride, second_stride, out_stride);
+		}
+
+		static void block_sse2_float(const float* first, const float* second, float* out, size_t rows, size_t inner, size_t cols, size_t first_stride, size_t second_stride, size_t out_stride) {
+			size_t i = 0;
+			//Tiles of 4 rows by 8 columns, held in registers
+			for(; i + 4 <= rows; i += 4) {
+				size_t j = 0;
+				for(; j + 8 <= cols; j += 8) {
+					float* c = out + i * out_stride + j;
+					__m128 c00 = _mm_loadu_ps(c);
+					__m128 c01 = _mm_loadu_ps(c + 4);
+					__m128 c10 = _mm_loadu_ps(c + out_stride);
+					__m128 c11 = _mm_loadu_ps(c + out_stride + 4);
+					__m128 c20 = _mm_loadu_ps(c + 2 * out_stride);
+					__m128 c21 = _mm_loadu_ps(c + 2 * out_stride + 4);
+					__m128 c30 = _mm_loadu_ps(c + 3 * out_stride);
+					__m128 c31 = _mm_loadu_ps(c + 3 * out_stride + 4);
+					const float* a = first + i * first_stride;
+					for(size_t k = 0; k < inner; k++) {
+						const float* b = second + k * second_stride + j;
+						__m128 b0 = _mm_loadu_ps(b);
+						__m128 b1 = _mm_loadu_ps(b + 4);
+						__m128 a0 = _mm_set1_ps(a[k]);
+						__m128 a1 = _mm_set1_ps(a[first_stride + k]);
+						__m128 a2 = _mm_set1_ps(a[2 * first_stride + k]);
+						__m128 a3 = _mm_set1_ps(a[3 * first_stride + k]);
+						c00 = _mm_add_ps(c00, _mm_mul_ps(a0, b0));
+						c01 = _mm_add_ps(c01, _mm_mul_ps(a0, b1));
+						c10 = _mm_add_ps(c10, _mm_mul_ps(a1, b0));
+						c11 = _mm_add_ps(c11, _mm_mul_ps(a1, b1));
+						c20 = _mm_add_ps(c20, _mm_mul_ps(a2, b0));
+						c21 = _mm_add_ps(c21, _mm_mul_ps(a2, b1));
+						c30 = _mm_add_ps(c30, _mm_mul_ps(a3, b0));
+						c31 = _mm_add_ps(c31, _mm_mul_ps(a3, b1));
+					}
+					_mm_storeu_ps(c, c00);
+					_mm_storeu_ps(c + 4, c01);
+					_mm_storeu_ps(c + out_stride, c10);
+					_mm_storeu_ps(c + out_stride + 4, c11);
+					_mm_storeu_ps(c + 2 * out_stride, c20);
+					_mm_storeu_ps(c + 2 * out_stride + 4, c21);
+					_mm_storeu_ps(c + 3 * out_stride, c30);
+					_mm_storeu_ps(c + 3 * out_stride + 4, c31);
+				}
+				//Leftover columns
+				block_generic(first + i * first_stride, second + j, out + i * out_stride + j, 4, inner, cols - j, first_stride, second_stride, out_stride);
+			}
+			//Leftover rows
+			block_generic(first + i * first_stride, second, out + i * out_stride, rows - i, inner, cols, first_stride, second_stride, out_stride);
+		}
+#endif
+
+#ifdef LAPIDAY_GEMM_X86
+		__attribute__((target("avx2,fma")))
+		static void block_avx2(const double* first, const double* second, double* out, size_t rows, size_t inner, size_t cols, size_t first_stride, size_t second_stride, size_t out_stride) {
+			size_t i = 0;
+			//Tiles of 4 rows by 8 columns, held in registers
+			for(; i + 4 <= rows; i += 4) {
+				size_t j = 0;
+				for(; j + 8 <= cols; j += 8) {
+					double* c = out + i * out_stride + j;
+					__m256d c00 = _mm256_loadu_pd(c);
+					__m256d c01 = _mm256_loadu_pd(c + 4);
+					__m256d c10 = _mm256_loadu_pd(c + out_stride);
+					__m256d c11 = _mm256_loadu_pd(c + out_stride + 4);
+					__m256d c20 = _mm256_loadu_pd(c + 2 * out_stride);
+					__m256d c21 = _mm256_loadu_pd(c + 2 * out_stride + 4);
+					__m256d c30 = _mm256_loadu_pd(c + 3 * out_stride);
+					__m256d c31 = _mm256_loadu_pd(c + 3 * out_stride + 4);
+					const double* a = first + i * first_stride;
+					for(size_t k = 0; k < inner; k++) {
+						const double* b = second + k * second_stride + j;
+						__m256d b0 = _mm256_loadu_pd(b);
+						__m256d b1 = _mm256_loadu_pd(b + 4);
+						__m256d a0 = _mm256_broadcast_sd(a + k);
+						__m256d a1 = _mm256_broadcast_sd(a + first_stride + k);
+						__m256d a2 = _mm256_broadcast_sd(a + 2 * first_stride + k);
+						__m256d a3 = _mm256_broadcast_sd(a + 3 * first_stride + k);
+						c00 = _mm256_fmadd_pd(a0, b0, c00);
+						c01 = _mm256_fmadd_pd(a0, b1, c01);
+						c10 = _mm256_fmadd_pd(a1, b0, c10);
+						c11 = _mm256_fmadd_pd(a1, b1, c11);
+						c20 = _mm256_fmadd_pd(a2, b0, c20);
+						c21 = _mm256_fmadd_pd(a2, b1, c21);
+						c30 = _mm256_fmadd_pd(a3, b0, c30);
+						c31 = _mm256_fmadd_pd(a3, b1, c31);
+					}
+					_mm256_storeu_pd(c, c00);
+					_mm256_storeu_pd(c + 4, c01);
+					_mm256_storeu_pd(c + out_stride, c10);
+					_mm256_storeu_pd(c + out_stride + 4, c11);
+					_mm256_storeu_pd(c + 2 * out_stride, c20);
+					_mm256_storeu_pd(c + 2 * out_stride + 4, c21);
+					_mm256_storeu_pd(c + 3 * out_stride, c30);
+					_mm256_storeu_pd(c + 3 * out_stride + 4, c31);
+				}
+				//Clear the upper halves of the registers, since
+				//the compiler does not do it for target functions
+				//and SSE code afterwards would run slowly
+				_mm256_zeroupper();
+				//Leftover columns
+				block_generic(first + i * first_stride, second + j, out + i * out_stride + j, 4, inner, cols - j, first_stride, second_stride, out_stride);
+			}
+			//Leftover rows
+			block_generic(first + i * first_stride, second, out + i * out_stride, rows - i, inner, cols, first_stride, second_stride, out_stride);
+		}
+
+		__attribute__((target("avx2,fma")))
+		static void block_avx2_float(const float* first, const float* second, float* out, size_t rows, size_t inner, size_t cols, size_t first_stride, size_t second_stride, size_t out_stride) {
+			size_t i = 0;
+			//Tiles of 4 rows by 16 columns, held in registers
+			for(; i + 4 <= rows; i += 4) {
+				size_t j = 0;
+				for(; j + 16 <= cols; j += 16) {
+					float* c = out + i * out_stride + j;
+					__m256 c00 = _mm256_loadu_ps(c);
+					__m256 c01 = _mm256_loadu_ps(c + 8);
+					__m256 c10 = _mm256_loadu_ps(c + out_stride);
+					__m256 c11 = _mm256_loadu_ps(c + out_stride + 8);
+					__m256 c20 = _mm256_loadu_ps(c + 2 * out_stride);
+					__m256 c21 = _mm256_loadu_ps(c + 2 * out_stride + 8);
+					__m256 c30 = _mm256_loadu_ps(c + 3 * out_stride);
+					__m256 c31 = _mm256_loadu_ps(c + 3 * out_stride + 8);
+					const float* a = first + i * first_stride;
+					for(size_t k = 0; k < inner; k++) {
+						const float* b = second + k * second_stride + j;
+						__m256 b0 = _mm256_loadu_ps(b);
+						__m256 b1 = _mm256_loadu_ps(b + 8);
+						__m256 a0 = _mm256_broadcast_ss(a + k);
+						__m256 a1 = _mm256_broadcast_ss(a + first_stride + k);
+						__m256 a2 = _mm256_broadcast_ss(a + 2 * first_stride + k);
+						__m256 a3 = _mm256_broadcast_ss(a + 3 * first_stride + k);
+						c00 = _mm256_fmadd_ps(a0, b0, c00);
+						c01 = _mm256_fmadd_ps(a0, b1, c01);
+						c10 = _mm256_fmadd_ps(a1, b0, c10);
+						c11 = _mm256_fmadd_ps(a1, b1, c11);
+						c20 = _mm256_fmadd_ps(a2, b0, c20);
+						c21 = _mm256_fmadd_ps(a2, b1, c21);
+						c30 = _mm256_fmadd_ps(a3, b0, c30);
+						c31 = _mm256_fmadd_ps(a3, b1, c31);
+					}
+					_mm256_storeu_ps(c, c00);
+					_mm256_storeu_ps(c + 8, c01);
+					_mm256_storeu_ps(c + out_stride, c10);
+					_mm256_storeu_ps(c + out_stride + 8, c11);
+					_mm256_storeu_ps(c + 2 * out_stride, c20);
+					_mm256_storeu_ps(c + 2 * out_stride + 8, c21);
+					_mm256_storeu_ps(c + 3 * out_stride, c30);
+					_mm256_storeu_ps(c + 3 * out_stride + 8, c31);
+				}
+				//As in block_avx2
+				_mm256_zeroupper();
+				//Leftover columns
+				block_generic(first + i * first_stride, second + j, out + i * out_stride + j, 4, inner, cols - j, first_stride, second_stride, out_stride);
+			}
+			//Leftover rows
+			block_generic(first + i * first_stride, second, out + i * out_stride, rows - i, inner, cols, first_stride, second_stride, out_stride);
+		}
+
+		/**
+		 * Check if the processor supports AVX2 and FMA.
+		 * @return true if it does, false otherwise
+		 */
+		static bool has_avx2() {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		}
+#endif
+
+		/**@{*/
+		/**
+		 * Choose the best block kernel for this processor.
+		 * @param tag Any value of the entry type
+		 * @return Block kernel
+		 */
+		static block_kernel<double>::type select_kernel(double) {
+#ifdef LAPIDAY_GEMM_X86
+			if(has_avx2()) {
+				return block_avx2;
+			}
+#endif
+#ifdef __SSE2__
+			return block_sse2;
+#else
+			return block_generic<double>;
+#endif
+		}
+
+		static block_kernel<float>::type select_kernel(float) {
+#ifdef LAPIDAY_GEMM_X86
+			if(has_avx2()) {
+				return block_avx2_float;
+			}
+#endif
+#ifdef __SSE2__
+			return block_sse2_float;
+#else
+			return block_generic<float>;
+#endif
+		}
+		/**@}*/
+
+		/**
+		 * Get the block kernel for this processor,
+		 * choosing it on the first call.
+		 * @return Block kernel
+		 */
+		template<class T>
+		static typename block_kernel<T>::type get_kernel() {
+			static const typename block_kernel<T>::type kernel = select_kernel(T());
+			return kernel;
+		}
+
+		template<class T>
+		void multiply_simple(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols) {
+			T entry;
+			for(size_t i = 0; i < rows; i++) {
+				for(size_t j = 0; j < cols; j++) {
+					entry = 0;
+					for(size_t k = 0; k < inner; k++) {
+						entry += (first[i * inner + k] * second[k * cols + j]);
+					}
+					out[i * cols + j] = entry;
+				}
+			}
+		}
+
+		/**
+		 * Multiply two matrices in cache-sized blocks,
+		 * where the rows of each factor are contiguous
+		 * but may be spaced apart.
+		 * @param first Entries of the first factor
+		 * @param first_stride Distance between rows of
+		 * the first factor
+		 * @param second Entries of the second factor
+		 * @param second_stride Distance between rows of
+		 * the second factor
+		 * @param out Entries of the product (row-major)
+		 * @param rows Number of rows of the first factor
+		 * @param inner Number of columns of the first factor
+		 * @param cols Number of columns of the second factor
+		 */
+		template<class T>
+		static void multiply_blocked_rows(const T* first, size_t first_stride, const T* second, size_t second_stride, T* out, size_t rows, size_t inner, size_t cols) {
+			typename block_kernel<T>::type kernel = get_kernel<T>();
+			fill(out, out + rows * cols, T(0));
+			for(size_t jj = 0; jj < cols; jj += COL_BLOCK) {
+				size_t nc = min(COL_BLOCK, cols - jj);
+				for(size_t kk = 0; kk < inner; kk += INNER_BLOCK) {
+					size_t kc = min(INNER_BLOCK, inner - kk);
+					for(size_t ii = 0; ii < rows; ii += ROW_BLOCK) {
+						size_t mc = min(ROW_BLOCK, rows - ii);
+						kernel(first + ii * first_stride + kk, second + kk * second_stride + jj, out + ii * cols + jj, mc, kc, nc, first_stride, second_stride, cols);
+					}
+				}
+			}
+		}
+
+		/**
+		 * Multiply two matrices as in multiply_blocked_rows(),
+		 * splitting large products between threads by rows
+		 * of the first factor. Each thread gets whole blocks
+		 * of ROW_BLOCK rows, which are computed exactly as
+		 * without threads.
+		 * @param first Entries of the first factor
+		 * @param first_stride Distance between rows of
+		 * the first factor
+		 * @param second Entries of the second factor
+		 * @param second_stride Distance between rows of
+		 * the second factor
+		 * @param out Entries of the product (row-major)
+		 * @param rows Number of rows of the first factor
+		 * @param inner Number of columns of the first factor
+		 * @param cols Number of columns of the second factor
+		 */
+		template<class T>
+		static void multiply_blocked_parallel(const T* first, size_t first_stride, const T* second, size_t second_stride, T* out, size_t rows, size_t inner, size_t cols) {
+			if(rows * inner * cols < parallel::PARALLEL_MIN_WORK) {
+				multiply_blocked_rows(first, first_stride, second, second_stride, out, rows, inner, cols);
+				return;
+			}
+			parallel::for_ranges(rows, ROW_BLOCK, [=](size_t begin, size_t end) {
+				multiply_blocked_rows(first + begin * first_stride, first_stride, second, second_stride, out + begin * cols, end - begin, inner, cols);
+			});
+		}
+
+		/**
+		 * Copy strided entries into a row-major array.
+		 * @param entries Entries to copy
+		 * @param row_stride Distance between rows
+		 * @param col_stride Distance between columns
+		 * @param rows Number of rows
+		 * @param cols Number of columns
+		 * @param packed Array to copy into
+		 */
+		template<class T>
+		static void pack(const T* entries, size_t row_stride, size_t col_stride, size_t rows, size_t cols, vector<T>& packed) {
+			packed.resize(rows * cols);
+			for(size_t i = 0; i < rows; i++) {
+				for(size_t j = 0; j < cols; j++) {
+					packed[i * cols + j] = entries[i * row_stride + j * col_stride];
+				}
+			}
+		}
+
+		template<class T>
+		void multiply_blocked(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols) {
+			multiply_blocked_parallel(first, inner, second, cols, out, rows, inner, cols);
+		}
+
+		template<class T>
+		void multiply(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols) {
+			if(rows * inner * cols >= BLOCKED_MIN_WORK) {
+				multiply_blocked(first, second, out, rows, inner, cols);
+			} else {
+				multiply_simple(first, second, out, rows, inner, cols);
+			}
+		}
+
+		template<class T>
+		void multiply_strided(const T* first, size_t first_row_stride, size_t first_col_stride, const T* second, size_t second_row_stride, size_t second_col_stride, T* out, size_t rows, size_t inner, size_t cols) {
+			if(rows * inner * cols < BLOCKED_MIN_WORK) {
+				T entry;
+				for(size_t i = 0; i < rows; i++) {
+					for(size_t j = 0; j < cols; j++) {
+						entry = 0;
+						for(size_t k = 0; k < inner; k++) {
+							entry += (first[i * first_row_stride + k * first_col_stride] * second[k * second_row_stride + j * second_col_stride]);
+						}
+						out[i * cols + j] = entry;
+					}
+				}
+				return;
+			}
+			//The block kernels need contiguous rows, so pack
+			//factors that do not have them (such as transposes)
+			vector<T> first_packed;
+			vector<T> second_packed;
+			if(first_col_stride != 1) {
+				pack(first, first_row_stride, first_col_stride, rows, inner, first_packed);
+				first = &first_packed[0];
+				first_row_stride = inner;
+			}
+			if(second_col_stride != 1) {
+				pack(second, second_row_stride, second_col_stride, inner, cols, second_packed);
+				second = &second_packed[0];
+				second_row_stride = cols;
+			}
+			multiply_blocked_parallel(first, first_row_stride, second, second_row_stride, out, rows, inner, cols);
+		}
+
+		const char* blocked_kernel_name() {
+			block_kernel<double>::type kernel = get_kernel<double>();
+#ifdef LAPIDAY_GEMM_X86
+			if(kernel == block_avx2) {
+				return "avx2";
+			}
+#endif
+#ifdef __SSE2__
+			if(kernel == block_sse2) {
+				return "sse2";
+			}
+#endif
+			return "generic";
+		}
+
+		template void multiply_simple<float>(const float* first, const float* second, float* out, size_t rows, size_t inner, size_t cols);
+		template void multiply_simple<double>(const double* first, const double* second, double* out, size_t rows, size_t inner, size_t cols);
+		template void multiply_blocked<float>(const float* first, const float* second, float* out, size_t rows, size_t inner, size_t cols);
+		template void multiply_blocked<double>(const double* first, const double* second, double* out, size_t rows, size_t inner, size_t cols);
+		template void multiply<float>(const float* first, const float* second, float* out, size_t rows, size_t inner, size_t cols);
+		template void multiply<double>(const double* first, const double* second, double* out, size_t rows, size_t inner, size_t cols);
+		template void multiply_strided<float>(const float* first, size_t first_row_stride, size_t first_col_stride, const float* second, size_t second_row_stride, size_t second_col_stride, float* out, size_t rows, size_t inner, size_t cols);
+		template void multiply_strided<double>(const double* first, size_t first_row_stride, size_t first_col_stride, const double* second, size_t second_row_stride, size_t second_col_stride, double* out, size_t rows, size_t inner, size_t cols);
+	}
+}
@@ -0,0 +1,103 @@
+#ifndef LAPIDAY_GEMM_H
+#define LAPIDAY_GEMM_H
+
+#include <cstddef>
+
+using std::size_t;
+
+/**
+ * Kernels for multiplying matrices stored as
+ * row-major arrays of floats or doubles (the only
+ * types the templates are instantiated for).
+ * The output array must not overlap either
+ * input array.
+ */
+namespace lapiday {
+	namespace gemm {
+		/**
+		 * Smallest amount of work (rows times inner
+		 * dimension times columns) for which the
+		 * blocked kernel is worth using
+		 */
+		const size_t BLOCKED_MIN_WORK = 32 * 32 * 32;
+
+		/**
+		 * Multiply two matrices with a plain triple loop.
+		 * This is fastest for small matrices.
+		 * @param first Entries of the first factor
+		 * @param second Entries of the second factor
+		 * @param out Entries of the product
+		 * @param rows Number of rows of the first factor
+		 * @param inner Number of columns of the first factor
+		 * (and rows of the second factor)
+		 * @param cols Number of columns of the second factor
+		 */
+		template<class T>
+		void multiply_simple(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols);
+
+		/**
+		 * Multiply two matrices in cache-sized blocks,
+		 * using the widest vector instructions the
+		 * processor supports (checked at run time).
+		 * @param first Entries of the first factor
+		 * @param second Entries of the second factor
+		 * @param out Entries of the product
+		 * @param rows Number of rows of the first factor
+		 * @param inner Number of columns of the first factor
+		 * (and rows of the second factor)
+		 * @param cols Number of columns of the second factor
+		 */
+		template<class T>
+		void multiply_blocked(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols);
+
+		/**
+		 * Multiply two matrices, choosing the blocked
+		 * kernel for large enough sizes.
+		 * @param first Entries of the first factor
+		 * @param second Entries of the second factor
+		 * @param out Entries of the product
+		 * @param rows Number of rows of the first factor
+		 * @param inner Number of columns of the first factor
+		 * (and rows of the second factor)
+		 * @param cols Number of columns of the second factor
+		 */
+		template<class T>
+		void multiply(const T* first, const T* second, T* out, size_t rows, size_t inner, size_t cols);
+
+		/**
+		 * Multiply two matrices whose entries are spaced
+		 * by the given strides, as in a view of a block
+		 * or a transpose. The product is stored in a
+		 * row-major array. Factors with contiguous rows
+		 * are multiplied in place, others are packed
+		 * into contiguous rows first if the blocked
+		 * kernel is used.
+		 * @param first Entries of the first factor
+		 * @param first_row_stride Distance between rows
+		 * of the first factor
+		 * @param first_col_stride Distance between columns
+		 * of the first factor
+		 * @param second Entries of the second factor
+		 * @param second_row_stride Distance between rows
+		 * of the second factor
+		 * @param second_col_stride Distance between columns
+		 * of the second factor
+		 * @param out Entries of the product
+		 * @param rows Number of rows of the first factor
+		 * @param inner Number of columns of the first factor
+		 * (and rows of the second factor)
+		 * @param cols Number of columns of the second factor
+		 */
+		template<class T>
+		void multiply_strided(const T* first, size_t first_row_stride, size_t first_col_stride, const T* second, size_t second_row_stride, size_t second_col_stride, T* out, size_t rows, size_t inner, size_t cols);
+
+		/**
+		 * Get the name of the vector instructions used
+		 * by the blocked kernels on this processor.
+		 * @return "avx2", "sse2" or "generic"
+		 */
+		const char* blocked_kernel_name();
+	}
+}
+
+#endif
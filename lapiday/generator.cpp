@@ -0,0 +1,315 @@
+#include "generator.h"
+#include "affine.h"
+#include "snowflake.h"
+#include "parallel.h"
+#include "rules.h"
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+using std::size_t;
+using std::vector;
+using std::out_of_range;
+using std::invalid_argument;
+using std::min;
+
+namespace lapiday {
+	namespace snowflake {
+		template<class T>
+		basic_generator<T>::basic_generator(const basic_line<T>& seed, size_t child_count, unsigned int levels, T min_length)
+			: _child_count(child_count), _children(child_count), _min_length(min_length) {
+			if(min_length > 0) {
+				//The number of lines depends on their lengths
+				_indexes.push_back(0);
+			} else {
+				_lines.reserve(line_count(child_count, levels));
+			}
+			_lines.push_back(seed);
+			_level_begins.reserve(levels + 1);
+			_level_begins.push_back(0);
+		}
+
+		template<class T>
+		size_t basic_generator<T>::line_count(size_t child_count, unsigned int levels) {
+			//Each level has child_count times as many
+			//lines as the one before it
+			size_t total = 1;
+			size_t level = 1;
+			for(unsigned int i = 0; i < levels; i++) {
+				level *= child_count;
+				total += level;
+			}
+			return total;
+		}
+
+		template<class T>
+		void basic_generator<T>::grow(const basic_affine<T>* children) {
+			size_t count = _add_level();
+			size_t begin = _level_begins[_level_begins.size() - 2];
+			size_t end = _level_begins.back();
+			if(count == 0) {
+				return;
+			}
+			if(_parents.empty()) {
+				expand_parallel(&_lines[begin], count, children, _child_count, &_lines[end]);
+				return;
+			}
+			const size_t* parents = _parents.data();
+			size_t child_count = _child_count;
+			basic_line<T>* lines = _lines.data();
+			parallel::for_chunks(count, EXPAND_CHUNK, [=](size_t first, size_t last) {
+				//Expand each run of neighbouring lines at once
+				size_t i = first;
+				while(i < last) {
+					size_t run = 1;
+					while((i + run < last) && (parents[i + run] == parents[i] + run)) {
+						run++;
+					}
+					expand(lines + parents[i], run, children, child_count, lines + end + i * child_count);
+					i += run;
+				}
+			});
+		}
+
+		template<class T>
+		void basic_generator<T>::grow(const child_rule& rule) {
+			size_t count = _add_level();
+			size_t begin = _level_begins[_level_begins.size() - 2];
+			size_t end = _level_begins.back();
+			const size_t* parents = _parents.empty() ? NULL : _parents.data();
+			for(size_t i = 0; i < count; i++) {
+				size_t parent = _parent(parents, begin, i);
+				rule(_lines[parent], _children.data());
+				//One parent at a time, with the same
+				//arithmetic as expand()
+				for(size_t k = 0; k < _child_count; k++) {
+					_lines[end + i * _child_count + k].transformation = _lines[parent].transformation * _children[k];
+				}
+			}
+		}
+
+		template<class T>
+		void basic_generator<T>::grow_parallel(const indexed_rule& rule) {
+			size_t count = _add_level();
+			size_t level = _level_begins.size() - 2;
+			size_t begin = _level_begins[level];
+			size_t end = _level_begins.back();
+			size_t child_count = _child_count;
+			const size_t* parents = _parents.empty() ? NULL : _parents.data();
+			const size_t* indexes = _indexes.empty() ? NULL : _indexes.data();
+			basic_line<T>* lines = _lines.data();
+			parallel::for_chunks(count, EXPAND_CHUNK, [=, &rule](size_t first, size_t last) {
+				//Each chunk has its own room for children
+				vector<basic_affine<T> > children(child_count);
+				for(size_t i = first; i < last; i++) {
+					size_t parent = _parent(parents, begin, i);
+					rule(lines[parent], level, _index(indexes, begin, parent), children.data());
+					basic_line<T>* out = lines + end + i * child_count;
+					for(size_t k = 0; k < child_count; k++) {
+						out[k].transformation = lines[parent].transformation * children[k];
+					}
+				}
+			});
+		}
+
+		template<class T>
+		void basic_generator<T>::grow(const basic_rule_set<T>& rules) {
+			if(rules.child_count() != _child_count) {
+				throw invalid_argument("Rule set has the wrong number of children");
+			}
+			if(rules.table() != NULL) {
+				grow(rules.table());
+			} else {
+				grow_parallel([&rules](const basic_line<T>&, size_t level, size_t index, basic_affine<T>* children) {
+					rules.children(level, index, children);
+				});
+			}
+		}
+
+		template<class T>
+		size_t basic_generator<T>::child_count() const {
+			return _child_count;
+		}
+
+		template<class T>
+		T basic_generator<T>::min_length() const {
+			return _min_length;
+		}
+
+		template<class T>
+		size_t basic_generator<T>::level_count() const {
+			return _level_begins.size();
+		}
+
+		template<class T>
+		size_t basic_generator<T>::level_begin(size_t level) const {
+			if(level >= _level_begins.size()) {
+				throw out_of_range("Level has not been grown");
+			}
+			return _level_begins[level];
+		}
+
+		template<class T>
+		size_t basic_generator<T>::level_end(size_t level) const {
+			if(level >= _level_begins.size()) {
+				throw out_of_range("Level has not been grown");
+			}
+			return (level + 1 < _level_begins.size()) ? _level_begins[level + 1] : _lines.size();
+		}
+
+		template<class T>
+		const vector<basic_line<T> >& basic_generator<T>::lines() const {
+			return _lines;
+		}
+
+		template<class T>
+		size_t basic_generator<T>::_add_level() {
+			size_t begin = _level_begins.back();
+			size_t end = _lines.size();
+			_level_begins.push_back(end);
+			_parents.clear();
+			if(_min_length <= 0) {
+				_lines.resize(end + (end - begin) * _child_count);
+				return end - begin;
+			}
+			//Only lines at least the minimum length are split
+			for(size_t i = begin; i < end; i++) {
+				if(_lines[i].length() >= _min_length) {
+					_parents.push_back(i);
+				}
+			}
+			size_t count = _parents.size();
+			_lines.resize(end + count * _child_count);
+			_indexes.resize(_lines.size());
+			for(size_t i = 0; i < count; i++) {
+				size_t index = _indexes[_parents[i]] * _child_count;
+				for(size_t k = 0; k < _child_count; k++) {
+					_indexes[end + i * _child_count + k] = index + k;
+				}
+			}
+			if(count == end - begin) {
+				//Every line is split, so they are
+				//all in one run
+				_parents.clear();
+			}
+			return count;
+		}
+
+		template<class T>
+		size_t basic_generator<T>::_parent(const size_t* parents, size_t begin, size_t i) {
+			return (parents != NULL) ? parents[i] : begin + i;
+		}
+
+		template<class T>
+		size_t basic_generator<T>::_index(const size_t* indexes, size_t begin, size_t line) {
+			return (indexes != NULL) ? indexes[line] : line - begin;
+		}
+
+		template<class T>
+		basic_walker<T>::basic_walker(const basic_line<T>* seeds, size_t seed_count, const basic_affine<T>* children, size_t child_count, unsigned int levels, T min_length)
+			: _seeds(seeds, seeds + seed_count), _next_seed(0), _fixed_children(children), _child_count(child_count), _levels(levels),
+			_min_length(min_length) {
+			_stack.reserve(levels);
+		}
+
+		template<class T>
+		basic_walker<T>::basic_walker(const basic_line<T>* seeds, size_t seed_count, const indexed_rule& rule, size_t child_count, unsigned int levels, T min_length)
+			: _seeds(seeds, seeds + seed_count), _next_seed(0), _fixed_children(NULL), _rule(rule), _child_count(child_count), _levels(levels),
+			_min_length(min_length), _rule_children(levels * child_count) {
+			_stack.reserve(levels);
+		}
+
+		template<class T>
+		basic_walker<T>::basic_walker(const basic_line<T>* seeds, size_t seed_count, const basic_rule_set<T>& rules, unsigned int levels, T min_length)
+			: _seeds(seeds, seeds + seed_count), _next_seed(0), _fixed_children(rules.table()), _child_count(rules.child_count()), _levels(levels),
+			_min_length(min_length) {
+			if(_fixed_children == NULL) {
+				const basic_rule_set<T>* r = &rules;
+				_rule = [r](const basic_line<T>&, size_t level, size_t index, basic_affine<T>* children) {
+					r->children(level, index, children);
+				};
+				_rule_children.resize(levels * _child_count);
+			}
+			_stack.reserve(levels);
+		}
+
+		template<class T>
+		bool basic_walker<T>::next(basic_line<T>& leaf) {
+			return next_batch(&leaf, 1) == 1;
+		}
+
+		template<class T>
+		size_t basic_walker<T>::next_batch(basic_line<T>* out, size_t max) {
+			size_t count = 0;
+			while(count < max) {
+				if(_stack.empty()) {
+					if(_next_seed == _seeds.size()) {
+						break;
+					}
+					size_t index = _next_seed++;
+					if((_levels == 0) || ((_min_length > 0) && (_seeds[index].length() < _min_length))) {
+						//The seed is a leaf
+						out[count++] = _seeds[index];
+					} else {
+						_push(_seeds[index], 0, index);
+					}
+					continue;
+				}
+				frame& top = _stack.back();
+				if(top.next_child == _child_count) {
+					_stack.pop_back();
+				} else if(top.level + 1 == _levels) {
+					//The children are leaves, so make as
+					//many as fit at once
+					size_t n = min(_child_count - top.next_child, max - count);
+					for(size_t k = 0; k < n; k++) {
+						out[count + k].transformation = top.line.transformation * top.children[top.next_child + k];
+					}
+					top.next_child += n;
+					count += n;
+				} else {
+					//One child at a time, with the same
+					//arithmetic as expand()
+					basic_line<T> child(top.line.transformation * top.children[top.next_child]);
+					size_t index = top.index * _child_count + top.next_child;
+					top.next_child++;
+					if((_min_length > 0) && (child.length() < _min_length)) {
+						//Too short to split
+						out[count++] = child;
+					} else {
+						_push(child, top.level + 1, index);
+					}
+				}
+			}
+			return count;
+		}
+
+		template<class T>
+		bool basic_walker<T>::done() const {
+			return _stack.empty() && (_next_seed == _seeds.size());
+		}
+
+		template<class T>
+		void basic_walker<T>::_push(const basic_line<T>& line, size_t level, size_t index) {
+			frame f;
+			f.line = line;
+			f.level = level;
+			f.index = index;
+			f.next_child = 0;
+			if(_fixed_children != NULL) {
+				f.children = _fixed_children;
+			} else {
+				basic_affine<T>* children = &_rule_children[level * _child_count];
+				_rule(line, level, index, children);
+				f.children = children;
+			}
+			_stack.push_back(f);
+		}
+
+		template class basic_generator<float>;
+		template class basic_generator<double>;
+		template class basic_walker<float>;
+		template class basic_walker<double>;
+	}
+}
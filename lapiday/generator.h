@@ -0,0 +1,491 @@
+#ifndef LAPIDAY_GENERATOR_H
+#define LAPIDAY_GENERATOR_H
+
+#include "affine.h"
+#include "snowflake.h"
+#include "rules.h"
+#include "parallel.h"
+#include <cstddef>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+using std::size_t;
+using std::out_of_range;
+using std::invalid_argument;
+
+namespace lapiday {
+	namespace snowflake {
+		/**
+		 * Grows a snowflake from a seed line, one
+		 * level at a time. Every line has the same
+		 * number of children, and the lines of each
+		 * level are stored after those of the level
+		 * before it, so only the newest level (the
+		 * frontier) is visited when growing.
+		 * With a minimum length, lines shorter than it
+		 * are not split, so the depth adapts to the
+		 * size the snowflake is drawn at; the children
+		 * of the remaining lines are still stored in
+		 * order.
+		 * Only float and double lines are supported;
+		 * generator is the double version.
+		 */
+		template<class T>
+		class basic_generator {
+		public:
+			/**
+			 * Rule giving the transformations from a
+			 * line to each of its children
+			 * (the line, then an array for the
+			 * transformations)
+			 */
+			typedef std::function<void(const basic_line<T>&, basic_affine<T>*)> child_rule;
+
+			/**
+			 * Rule giving the transformations from a
+			 * line to each of its children, given where
+			 * the line is (the line, its level, its index
+			 * in the level, then an array for the
+			 * transformations). It may be called from
+			 * several threads at once, so it must only
+			 * depend on its arguments.
+			 */
+			typedef std::function<void(const basic_line<T>&, size_t, size_t, basic_affine<T>*)> indexed_rule;
+
+			/**
+			 * Start a snowflake with a single line,
+			 * reserving room for the given number
+			 * of levels.
+			 * @param seed First line (level 0)
+			 * @param child_count Number of children
+			 * of each line
+			 * @param levels Number of levels that
+			 * will be grown (at most, with a minimum
+			 * length, and then no room is reserved
+			 * for their lines)
+			 * @param min_length Length below which
+			 * lines get no children, in the units of
+			 * the lines (pixels, if they are drawn
+			 * without scaling), or 0 to split every line
+			 */
+			basic_generator(const basic_line<T>& seed, size_t child_count, unsigned int levels, T min_length = 0);
+
+			/**
+			 * Get the number of lines in a snowflake
+			 * grown from one line, counting every level.
+			 * @param child_count Number of children
+			 * of each line
+			 * @param levels Number of levels grown
+			 * @return 1 + c + c^2 + ... + c^levels,
+			 * where c is child_count
+			 */
+			static size_t line_count(size_t child_count, unsigned int levels);
+
+			/**
+			 * Grow one level, giving every line of the
+			 * frontier (that is not too short) the same
+			 * children. Large levels are split between
+			 * threads.
+			 * @param children Transformations from a
+			 * line to each of its children
+			 */
+			void grow(const basic_affine<T>* children);
+
+			/**
+			 * Grow one level, asking the rule for the
+			 * children of each line of the frontier
+			 * (that is not too short), in order.
+			 * @param rule Rule giving the children
+			 * of a line
+			 */
+			void grow(const child_rule& rule);
+
+			/**
+			 * Grow one level, asking the rule for the
+			 * children of each line of the frontier
+			 * (that is not too short).
+			 * Large levels are split into chunks shared
+			 * between threads, and each line's children
+			 * are stored in a fixed place, so the result
+			 * does not depend on the number of threads.
+			 * The index given to the rule is the line's
+			 * index in its level as if no line had been
+			 * left unsplit, so the children of a line do
+			 * not depend on the minimum length.
+			 * @param rule Rule giving the children
+			 * of a line
+			 * @throw Any exception thrown by the rule
+			 */
+			void grow_parallel(const indexed_rule& rule);
+
+			/**
+			 * Grow one level with the children from a
+			 * rule set, splitting large levels between
+			 * threads.
+			 * @param rules Rule set
+			 * @throw invalid_argument If the rule set does
+			 * not give the right number of children
+			 */
+			void grow(const basic_rule_set<T>& rules);
+
+			/**
+			 * Grow one level with the children from a
+			 * rule set fixed at compile time (such as
+			 * basic_static_branching), splitting large
+			 * levels between threads.
+			 * Rules must have a static CHILD_COUNT and
+			 * a const member children(level, index, out)
+			 * that is safe to call from several threads.
+			 * @param rules Rule set
+			 * @throw invalid_argument If the rule set does
+			 * not give the right number of children
+			 */
+			template<class Rules>
+			void grow_static(const Rules& rules);
+
+			/**
+			 * Get the number of children of each line.
+			 * @return Number of children
+			 */
+			size_t child_count() const;
+
+			/**
+			 * Get the length below which lines
+			 * get no children.
+			 * @return Minimum length (0 if every
+			 * line is split)
+			 */
+			T min_length() const;
+
+			/**
+			 * Get the number of levels, counting
+			 * the seed.
+			 * @return Number of levels
+			 */
+			size_t level_count() const;
+
+			/**
+			 * Get the index of the first line
+			 * of a level.
+			 * @param level Level (0 for the seed)
+			 * @return Index in lines()
+			 * @throw out_of_range If the level has
+			 * not been grown
+			 */
+			size_t level_begin(size_t level) const;
+
+			/**
+			 * Get the index one past the last line
+			 * of a level.
+			 * @param level Level (0 for the seed)
+			 * @return Index in lines()
+			 * @throw out_of_range If the level has
+			 * not been grown
+			 */
+			size_t level_end(size_t level) const;
+
+			/**
+			 * Get every line grown so far, level
+			 * by level.
+			 * @return Lines
+			 */
+			const std::vector<basic_line<T> >& lines() const;
+		private:
+			/**
+			 * Lines of every level
+			 */
+			std::vector<basic_line<T> > _lines;
+
+			/**
+			 * Index of the first line of each level
+			 */
+			std::vector<size_t> _level_begins;
+
+			/**
+			 * Number of children of each line
+			 */
+			size_t _child_count;
+
+			/**
+			 * Children of one line, filled in by a rule
+			 */
+			std::vector<basic_affine<T> > _children;
+
+			/**
+			 * Length below which lines get no children
+			 */
+			T _min_length;
+
+			/**
+			 * Indexes in lines() of the lines of the
+			 * frontier being split (empty if all of
+			 * them are)
+			 */
+			std::vector<size_t> _parents;
+
+			/**
+			 * Index of each line in its level as if
+			 * every line had been split (empty if
+			 * there is no minimum length)
+			 */
+			std::vector<size_t> _indexes;
+
+			/**
+			 * Start a new level with room for the
+			 * children of the lines of the frontier
+			 * that are not too short.
+			 * @return Number of lines being split
+			 */
+			size_t _add_level();
+
+			/**
+			 * Get a line being split in the newest
+			 * level.
+			 * @param parents Indexes of the lines being
+			 * split, or NULL if all of them are
+			 * @param begin Index of the first line
+			 * of the frontier
+			 * @param i Which line being split
+			 * @return Index of the line in lines()
+			 */
+			static size_t _parent(const size_t* parents, size_t begin, size_t i);
+
+			/**
+			 * Get the index of a line in its level as
+			 * if every line had been split.
+			 * @param indexes Index of each line,
+			 * or NULL if every line was split
+			 * @param begin Index of the first line
+			 * of its level
+			 * @param line Index of the line in lines()
+			 * @return Index for the rules
+			 */
+			static size_t _index(const size_t* indexes, size_t begin, size_t line);
+		};
+
+		/**
+		 * Generator of lines with double transformations
+		 */
+		typedef basic_generator<double> generator;
+
+		template<class T>
+		template<class Rules>
+		void basic_generator<T>::grow_static(const Rules& rules) {
+			const size_t CHILD_COUNT = Rules::CHILD_COUNT;
+			if(CHILD_COUNT != _child_count) {
+				throw invalid_argument("Rule set has the wrong number of children");
+			}
+			size_t count = _add_level();
+			size_t level = _level_begins.size() - 2;
+			size_t begin = _level_begins[level];
+			size_t end = _level_begins.back();
+			const size_t* parents = _parents.empty() ? NULL : _parents.data();
+			const size_t* indexes = _indexes.empty() ? NULL : _indexes.data();
+			basic_line<T>* lines = _lines.data();
+			parallel::for_chunks(count, EXPAND_CHUNK, [=, &rules](size_t first, size_t last) {
+				basic_affine<T> children[CHILD_COUNT];
+				for(size_t i = first; i < last; i++) {
+					size_t parent = _parent(parents, begin, i);
+					rules.children(level, _index(indexes, begin, parent), children);
+					expand_static<CHILD_COUNT>(lines + parent, 1, children, lines + end + i * CHILD_COUNT);
+				}
+			});
+		}
+
+		/**
+		 * Walks the lines of a snowflake depth-first,
+		 * giving only the lines of the last level (the
+		 * leaves) without storing the levels above them.
+		 * Only the path from a seed to the current line
+		 * is kept, so memory does not grow with the
+		 * number of lines. The leaves come out in the
+		 * same order, with the same values, as the last
+		 * level of a generator grown from the same seeds.
+		 * With a minimum length, lines shorter than it
+		 * are leaves too, wherever they are, so the
+		 * depth adapts to the size the snowflake is
+		 * drawn at.
+		 * Only float and double lines are supported;
+		 * walker is the double version.
+		 */
+		template<class T>
+		class basic_walker {
+		public:
+			/**
+			 * Rule giving the children of a line from
+			 * where it is, as for a generator
+			 */
+			typedef typename basic_generator<T>::indexed_rule indexed_rule;
+
+			/**
+			 * Start walking from the given seeds, giving
+			 * every line the same children.
+			 * @param seeds First lines (level 0)
+			 * @param seed_count Number of seeds
+			 * @param children Transformations from a
+			 * line to each of its children (not copied,
+			 * so they must outlive the walker)
+			 * @param child_count Number of children
+			 * of each line
+			 * @param levels Level of the leaves
+			 * (the deepest, with a minimum length)
+			 * @param min_length Length below which
+			 * lines are leaves, or 0 to split every
+			 * line above the last level
+			 */
+			basic_walker(const basic_line<T>* seeds, size_t seed_count, const basic_affine<T>* children, size_t child_count, unsigned int levels, T min_length = 0);
+
+			/**
+			 * Start walking from the given seeds, asking
+			 * the rule for the children of each line.
+			 * The index of seed i in level 0 is i.
+			 * @param seeds First lines (level 0)
+			 * @param seed_count Number of seeds
+			 * @param rule Rule giving the children
+			 * of a line
+			 * @param child_count Number of children
+			 * of each line
+			 * @param levels Level of the leaves
+			 * (the deepest, with a minimum length)
+			 * @param min_length Length below which
+			 * lines are leaves, or 0 to split every
+			 * line above the last level
+			 */
+			basic_walker(const basic_line<T>* seeds, size_t seed_count, const indexed_rule& rule, size_t child_count, unsigned int levels, T min_length = 0);
+
+			/**
+			 * Start walking from the given seeds, with
+			 * the children from a rule set.
+			 * @param seeds First lines (level 0)
+			 * @param seed_count Number of seeds
+			 * @param rules Rule set (not copied, so it
+			 * must outlive the walker)
+			 * @param levels Level of the leaves
+			 * (the deepest, with a minimum length)
+			 * @param min_length Length below which
+			 * lines are leaves, or 0 to split every
+			 * line above the last level
+			 */
+			basic_walker(const basic_line<T>* seeds, size_t seed_count, const basic_rule_set<T>& rules, unsigned int levels, T min_length = 0);
+
+			/**
+			 * Get the next leaf.
+			 * @param leaf Set to the next leaf
+			 * @return true if there was a leaf left,
+			 * false if the walk is finished
+			 */
+			bool next(basic_line<T>& leaf);
+
+			/**
+			 * Get the next leaves, as many as fit.
+			 * @param out Array for the leaves
+			 * @param max Number of leaves that fit
+			 * @return Number of leaves stored, which is
+			 * less than max only at the end of the walk
+			 */
+			size_t next_batch(basic_line<T>* out, size_t max);
+
+			/**
+			 * Check if every leaf has been given.
+			 * @return true if the walk is finished,
+			 * false otherwise
+			 */
+			bool done() const;
+		private:
+			/**
+			 * Line on the path from a seed to
+			 * the current line
+			 */
+			struct frame {
+				/**
+				 * The line
+				 */
+				basic_line<T> line;
+
+				/**
+				 * Level of the line
+				 */
+				size_t level;
+
+				/**
+				 * Index of the line in its level
+				 */
+				size_t index;
+
+				/**
+				 * Transformations to its children
+				 */
+				const basic_affine<T>* children;
+
+				/**
+				 * Next child to visit
+				 */
+				size_t next_child;
+			};
+
+			/**
+			 * Seeds
+			 */
+			std::vector<basic_line<T> > _seeds;
+
+			/**
+			 * Next seed to start from
+			 */
+			size_t _next_seed;
+
+			/**
+			 * Children of every line (NULL if
+			 * there is a rule)
+			 */
+			const basic_affine<T>* _fixed_children;
+
+			/**
+			 * Rule giving the children of a line
+			 */
+			indexed_rule _rule;
+
+			/**
+			 * Number of children of each line
+			 */
+			size_t _child_count;
+
+			/**
+			 * Level of the leaves
+			 */
+			size_t _levels;
+
+			/**
+			 * Length below which lines are leaves
+			 */
+			T _min_length;
+
+			/**
+			 * Path from a seed to the current line,
+			 * at most one line per level
+			 */
+			std::vector<frame> _stack;
+
+			/**
+			 * Children from the rule for each line on
+			 * the path, child_count per level
+			 */
+			std::vector<basic_affine<T> > _rule_children;
+
+			/**
+			 * Add a line to the path.
+			 * @param line Line
+			 * @param level Level of the line
+			 * @param index Index of the line in its level
+			 */
+			void _push(const basic_line<T>& line, size_t level, size_t index);
+		};
+
+		/**
+		 * Walker over lines with double transformations
+		 */
+		typedef basic_walker<double> walker;
+	}
+}
+
+#endif
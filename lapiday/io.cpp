@@ -0,0 +1,399 @@
+#include "io.h"
+#include "matrix.h"
+#include "view.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using std::size_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::memcmp;
+using std::memcpy;
+using std::runtime_error;
+using std::out_of_range;
+using std::ostream;
+using std::istream;
+using std::string;
+using std::vector;
+using std::numeric_limits;
+using std::min;
+using std::move;
+
+namespace lapiday {
+	namespace matrix {
+		/**
+		* Magic number at the start of a binary matrix file
+		*/
+		const char BINARY_MAGIC[4] = {'L', 'P', 'D', 'M'};
+
+		/**
+		* Current version of the binary format
+		*/
+		const uint32_t BINARY_VERSION = 1;
+
+		/**
+		* Byte order mark of the binary format
+		*/
+		const uint32_t BINARY_BYTE_ORDER = 0x01020304;
+
+		/**
+		* Number of entries converted at a time when reading
+		* a file with the other scalar type
+		*/
+		const size_t CONVERT_CHUNK = 4096;
+
+		/**
+		* Number of entries read at a time from a stream
+		* whose length is not known
+		*/
+		const size_t READ_CHUNK = 1 << 16;
+
+		/**
+		* Get the code for a scalar type in the binary format.
+		* @return Code of T
+		*/
+		template<class T>
+		static uint32_t scalar_code();
+
+		template<>
+		uint32_t scalar_code<float>() {
+			return scalar_float;
+		}
+
+		template<>
+		uint32_t scalar_code<double>() {
+			return scalar_double;
+		}
+
+		/**
+		* Check that a header describes a matrix that
+		* can be read on this machine.
+		* @param header Header
+		* @return Number of entries
+		* @throw runtime_error If the header is not valid
+		*/
+		static size_t check_header(const binary_header& header) {
+			if(memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) {
+				throw runtime_error("Not a binary matrix file");
+			}
+			if(header.version != BINARY_VERSION) {
+				throw runtime_error("Unsupported binary matrix file version");
+			}
+			if(header.byte_order != BINARY_BYTE_ORDER) {
+				throw runtime_error("Binary matrix file has a different byte order");
+			}
+			if((header.type != scalar_float) && (header.type != scalar_double)) {
+				throw runtime_error("Unknown scalar type in binary matrix file");
+			}
+			//Written to avoid overflow in rows * cols
+			uint64_t limit = numeric_limits<size_t>::max() / sizeof(double);
+			if((header.rows > limit) || (header.cols > limit) || ((header.cols > 0) && (header.rows > limit / header.cols))) {
+				throw runtime_error("Binary matrix file is too large");
+			}
+			return static_cast<size_t>(header.rows * header.cols);
+		}
+
+		/**
+		* Read entries of another scalar type from the
+		* stream, converting them a chunk at a time.
+		* @param in Stream to read from
+		* @param out Converted entries
+		* @param count Number of entries
+		*/
+		template<class T, class U>
+		static void read_converted(istream& in, T* out, size_t count) {
+			vector<U> chunk(min(count, CONVERT_CHUNK));
+			for(size_t done = 0; done < count; ) {
+				size_t n = min(count - done, CONVERT_CHUNK);
+				in.read(reinterpret_cast<char*>(&chunk[0]), n * sizeof(U));
+				if(!in) {
+					return;
+				}
+				for(size_t i = 0; i < n; i++) {
+					out[done + i] = static_cast<T>(chunk[i]);
+				}
+				done += n;
+			}
+		}
+
+		template<class T>
+		void write_binary(ostream& out, const basic_const_matrix_view<T>& m) {
+			binary_header header;
+			memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+			header.version = BINARY_VERSION;
+			header.type = scalar_code<T>();
+			header.byte_order = BINARY_BYTE_ORDER;
+			header.rows = m.rows();
+			header.cols = m.cols();
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			size_t rows = m.rows();
+			size_t cols = m.cols();
+			const T* entries = m.data();
+			if((rows > 0) && (cols > 0)) {
+				if((m.col_stride() == 1) && ((m.row_stride() == cols) || (rows == 1))) {
+					//Contiguous, so write everything at once
+					out.write(reinterpret_cast<const char*>(entries), rows * cols * sizeof(T));
+				} else if(m.col_stride() == 1) {
+					for(size_t i = 0; i < rows; i++) {
+						out.write(reinterpret_cast<const char*>(entries + i * m.row_stride()), cols * sizeof(T));
+					}
+				} else {
+					//Gather each row first
+					vector<T> row(cols);
+					for(size_t i = 0; i < rows; i++) {
+						for(size_t j = 0; j < cols; j++) {
+							row[j] = entries[i * m.row_stride() + j * m.col_stride()];
+						}
+						out.write(reinterpret_cast<const char*>(&row[0]), cols * sizeof(T));
+					}
+				}
+			}
+			if(!out) {
+				throw runtime_error("Could not write binary matrix");
+			}
+		}
+
+		/**
+		* Read entries from the stream, converting them if
+		* the file has the other scalar type.
+		* @param in Stream to read from
+		* @param type Scalar type of the file
+		* @param out Entries read
+		* @param count Number of entries
+		*/
+		template<class T>
+		static void read_entries(istream& in, uint32_t type, T* out, size_t count) {
+			if(type == scalar_code<T>()) {
+				in.read(reinterpret_cast<char*>(out), count * sizeof(T));
+			} else if(type == scalar_float) {
+				read_converted<T, float>(in, out, count);
+			} else {
+				read_converted<T, double>(in, out, count);
+			}
+		}
+
+		/**
+		* Find the number of bytes left in the stream, if
+		* it can seek.
+		* @param in Stream
+		* @param remaining Number of bytes left
+		* @return Whether the number of bytes is known
+		*/
+		static bool remaining_bytes(istream& in, uint64_t& remaining) {
+			istream::pos_type here = in.tellg();
+			if(here == istream::pos_type(-1)) {
+				in.clear();
+				return false;
+			}
+			in.seekg(0, std::ios::end);
+			istream::pos_type end = in.tellg();
+			in.clear();
+			in.seekg(here);
+			if(!in || (end == istream::pos_type(-1)) || (end < here)) {
+				in.clear();
+				return false;
+			}
+			remaining = static_cast<uint64_t>(end - here);
+			return true;
+		}
+
+		template<class T>
+		void read_binary(istream& in, basic_matrix<T>& m) {
+			binary_header header;
+			in.read(reinterpret_cast<char*>(&header), sizeof(header));
+			if(!in) {
+				throw runtime_error("Not a binary matrix file");
+			}
+			size_t count = check_header(header);
+			size_t rows = static_cast<size_t>(header.rows);
+			size_t cols = static_cast<size_t>(header.cols);
+			uint64_t size = (header.type == scalar_float) ? sizeof(float) : sizeof(double);
+			//The header alone must not decide how much is
+			//allocated, so check the stream really holds
+			//the entries first
+			basic_matrix<T> temp;
+			uint64_t remaining;
+			if(remaining_bytes(in, remaining)) {
+				if(remaining / size < count) {
+					throw runtime_error("Binary matrix file ended early");
+				}
+				temp._allocate(rows, cols);
+				read_entries(in, header.type, temp._entries, count);
+			} else {
+				//Can't tell how long the stream is, so read
+				//it a chunk at a time into a growing buffer
+				vector<T> entries;
+				for(size_t done = 0; done < count; ) {
+					size_t n = min(count - done, READ_CHUNK);
+					entries.resize(done + n);
+					read_entries(in, header.type, &entries[done], n);
+					if(!in) {
+						break;
+					}
+					done += n;
+				}
+				if(in) {
+					temp._allocate(rows, cols);
+					std::copy(entries.begin(), entries.end(), temp._entries);
+				}
+			}
+			if(!in) {
+				throw runtime_error("Binary matrix file ended early");
+			}
+			m = move(temp);
+		}
+
+		/**
+		* Unmap a mapping made by basic_mapped_matrix.
+		* @param mapping Start of the mapping
+		* @param length Length of the mapping in bytes
+		*/
+		static void unmap(void* mapping, size_t length) {
+#ifdef _WIN32
+			(void) length;
+			UnmapViewOfFile(mapping);
+#else
+			munmap(mapping, length);
+#endif
+		}
+
+		template<class T>
+		basic_mapped_matrix<T>::basic_mapped_matrix(const string& path) {
+			_mapping = NULL;
+			_length = 0;
+#ifdef _WIN32
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(file == INVALID_HANDLE_VALUE) {
+				throw runtime_error("Could not open " + path);
+			}
+			LARGE_INTEGER size;
+			if(!GetFileSizeEx(file, &size) || (static_cast<uint64_t>(size.QuadPart) < sizeof(binary_header)) || (static_cast<uint64_t>(size.QuadPart) > numeric_limits<size_t>::max())) {
+				CloseHandle(file);
+				throw runtime_error("Not a binary matrix file: " + path);
+			}
+			_length = static_cast<size_t>(size.QuadPart);
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(mapping != NULL) {
+				_mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				//The view keeps the file mapped
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			if(_mapping == NULL) {
+				throw runtime_error("Could not map " + path);
+			}
+#else
+			int fd = open(path.c_str(), O_RDONLY);
+			if(fd < 0) {
+				throw runtime_error("Could not open " + path);
+			}
+			struct stat info;
+			if((fstat(fd, &info) != 0) || (static_cast<uint64_t>(info.st_size) < sizeof(binary_header)) || (static_cast<uint64_t>(info.st_size) > numeric_limits<size_t>::max())) {
+				close(fd);
+				throw runtime_error("Not a binary matrix file: " + path);
+			}
+			_length = static_cast<size_t>(info.st_size);
+			void* mapping = mmap(NULL, _length, PROT_READ, MAP_PRIVATE, fd, 0);
+			//The mapping keeps the file open
+			close(fd);
+			if(mapping == MAP_FAILED) {
+				throw runtime_error("Could not map " + path);
+			}
+			_mapping = mapping;
+#endif
+			const binary_header* header = static_cast<const binary_header*>(_mapping);
+			try {
+				size_t count = check_header(*header);
+				if(header->type != scalar_code<T>()) {
+					throw runtime_error("Binary matrix file has a different scalar type");
+				}
+				if((_length - sizeof(binary_header)) / sizeof(T) < count) {
+					throw runtime_error("Binary matrix file ended early");
+				}
+			} catch(...) {
+				unmap(_mapping, _length);
+				throw;
+			}
+			_rows = static_cast<size_t>(header->rows);
+			_cols = static_cast<size_t>(header->cols);
+		}
+
+		template<class T>
+		basic_mapped_matrix<T>::basic_mapped_matrix(basic_mapped_matrix&& m) {
+			_mapping = m._mapping;
+			_length = m._length;
+			_rows = m._rows;
+			_cols = m._cols;
+			m._mapping = NULL;
+			m._length = 0;
+			m._rows = 0;
+			m._cols = 0;
+		}
+
+		template<class T>
+		basic_mapped_matrix<T>::~basic_mapped_matrix() {
+			if(_mapping != NULL) {
+				unmap(_mapping, _length);
+			}
+		}
+
+		template<class T>
+		size_t basic_mapped_matrix<T>::rows() const {
+			return _rows;
+		}
+
+		template<class T>
+		size_t basic_mapped_matrix<T>::cols() const {
+			return _cols;
+		}
+
+		template<class T>
+		const T* basic_mapped_matrix<T>::data() const {
+			if(_mapping == NULL) {
+				return NULL;
+			}
+			return reinterpret_cast<const T*>(static_cast<const char*>(_mapping) + sizeof(binary_header));
+		}
+
+		template<class T>
+		T basic_mapped_matrix<T>::operator()(size_t i, size_t j) const {
+			if((i < _rows) && (j < _cols)) {
+				return data()[i * _cols + j];
+			} else {
+				throw out_of_range("Element index out of range");
+			}
+		}
+
+		template<class T>
+		basic_const_matrix_view<T> basic_mapped_matrix<T>::view() const {
+			return basic_const_matrix_view<T>(data(), _rows, _cols, _cols, 1);
+		}
+
+		template void write_binary(ostream&, const basic_const_matrix_view<float>&);
+		template void write_binary(ostream&, const basic_const_matrix_view<double>&);
+		template void read_binary(istream&, basic_matrix<float>&);
+		template void read_binary(istream&, basic_matrix<double>&);
+		template class basic_mapped_matrix<float>;
+		template class basic_mapped_matrix<double>;
+	}
+}
@@ -0,0 +1,204 @@
+#ifndef LAPIDAY_IO_H
+#define LAPIDAY_IO_H
+
+#include "matrix.h"
+#include "view.h"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+
+using std::size_t;
+using std::runtime_error;
+using std::ostream;
+using std::istream;
+
+namespace lapiday {
+	namespace matrix {
+		/**
+		* Type of the entries in a binary matrix file
+		*/
+		enum binary_scalar_type {
+			scalar_float = 1,
+			scalar_double = 2
+		};
+
+		/**
+		* Header at the start of a binary matrix file.
+		* The entries follow it directly, row by row, in
+		* the byte order of the machine that wrote them.
+		* The header is 32 bytes, so the entries are
+		* aligned when the file is mapped into memory.
+		*/
+		struct binary_header {
+			/**
+			* Always "LPDM"
+			*/
+			char magic[4];
+
+			/**
+			* Version of the format (currently 1)
+			*/
+			std::uint32_t version;
+
+			/**
+			* Type of the entries (a binary_scalar_type)
+			*/
+			std::uint32_t type;
+
+			/**
+			* 0x01020304 as written, to detect files
+			* from machines with the other byte order
+			*/
+			std::uint32_t byte_order;
+
+			/**
+			* Number of rows
+			*/
+			std::uint64_t rows;
+
+			/**
+			* Number of columns
+			*/
+			std::uint64_t cols;
+		};
+
+		/**@{*/
+		/**
+		* Write a matrix to the stream in the binary format.
+		* The stream should be opened in binary mode.
+		* @param out Stream to write to
+		* @param m Matrix or view to write
+		* @throw runtime_error If the stream fails
+		*/
+		template<class T>
+		void write_binary(ostream& out, const basic_const_matrix_view<T>& m);
+
+		template<class T>
+		void write_binary(ostream& out, const basic_matrix<T>& m) {
+			write_binary(out, m.view());
+		}
+		/**@}*/
+
+		/**
+		* Read a matrix in the binary format from the stream,
+		* converting the entries if the file has the other
+		* scalar type. The stream should be opened in
+		* binary mode.
+		* @param in Stream to read from
+		* @param m Matrix to store the result in
+		* @throw runtime_error If the stream does not contain
+		* a matrix in the binary format, or ends too early
+		*/
+		template<class T>
+		void read_binary(istream& in, basic_matrix<T>& m);
+
+		/**
+		* Read-only matrix backed by a binary matrix file
+		* mapped into memory. The entries are not read or
+		* copied until they are used, so even very large
+		* matrices open instantly. The file must have the
+		* same scalar type and byte order as T.
+		* Only float and double entries are supported;
+		* mapped_matrix is the double version.
+		*/
+		template<class T>
+		class basic_mapped_matrix {
+		public:
+			/**
+			* Map a binary matrix file into memory.
+			* @param path Path of the file
+			* @throw runtime_error If the file cannot be
+			* mapped, or is not a matrix in the binary
+			* format with entries of type T
+			*/
+			explicit basic_mapped_matrix(const std::string& path);
+
+			/**
+			* Take over the mapping of another mapped matrix,
+			* leaving it empty.
+			* @param m Mapped matrix to move from
+			*/
+			basic_mapped_matrix(basic_mapped_matrix&& m);
+
+			/**
+			* Unmap the file.
+			*/
+			~basic_mapped_matrix();
+
+			/**
+			* Get the number of rows of this matrix.
+			* @return Number of rows
+			*/
+			size_t rows() const;
+
+			/**
+			* Get the number of columns of this matrix.
+			* @return Number of columns
+			*/
+			size_t cols() const;
+
+			/**
+			* Get the entries of this matrix, row by row.
+			* @return Pointer to entry (0, 0)
+			*/
+			const T* data() const;
+
+			/**
+			* Get the entry at the given position.
+			* @param i Row (zero-based)
+			* @param j Column (zero-based)
+			* @return Entry
+			* @throw out_of_range If the row or column
+			* is not in the range of this matrix
+			*/
+			T operator()(size_t i, size_t j) const;
+
+			/**
+			* Get a view of all entries of this matrix,
+			* which can be used in products or copied
+			* into a matrix.
+			* @return View of the entries
+			*/
+			basic_const_matrix_view<T> view() const;
+		private:
+			/**
+			* Start of the mapping (NULL if moved from)
+			*/
+			void* _mapping;
+
+			/**
+			* Length of the mapping in bytes
+			*/
+			size_t _length;
+
+			/**
+			* Number of rows
+			*/
+			size_t _rows;
+
+			/**
+			* Number of columns
+			*/
+			size_t _cols;
+
+			/**
+			* Mappings cannot be copied
+			*/
+			basic_mapped_matrix(const basic_mapped_matrix&);
+
+			/**
+			* Mappings cannot be copied
+			*/
+			basic_mapped_matrix& operator =(const basic_mapped_matrix&);
+		};
+
+		/**
+		* Mapped matrix of doubles
+		*/
+		typedef basic_mapped_matrix<double> mapped_matrix;
+	}
+}
+
+#endif
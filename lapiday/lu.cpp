@@ -0,0 +1,191 @@
+#include "lu.h"
+#include "matrix.h"
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using std::size_t;
+using std::logic_error;
+using std::invalid_argument;
+using std::vector;
+using std::fabs;
+using std::max;
+using std::numeric_limits;
+
+namespace lapiday {
+	namespace matrix {
+		template<class T>
+		basic_lu<T>::basic_lu(const basic_matrix<T>& m) : _factors(m) {
+			if(!m.square()) {
+				throw logic_error("Matrix is not square");
+			}
+			//The copy may share the entries of m
+			_factors._unshare();
+			size_t n = _factors._rows;
+			T* entries = _factors._entries;
+			_invertible = true;
+			//The entries of m are untouched, and stored in full
+			const T* original = m._entries;
+			rowop op;
+			op.type = rowop_switch;
+			op.multiplier = 1;
+			for(size_t k = 0; k < n; k++) {
+				//Partial pivoting: use the largest entry
+				//in the column to limit rounding error
+				size_t best = k;
+				for(size_t i = k + 1; i < n; i++) {
+					if(fabs(entries[i * n + k]) > fabs(entries[best * n + k])) {
+						best = i;
+					}
+				}
+				if(best != k) {
+					if(_switches.empty()) {
+						//At most one switch per column
+						_switches.reserve(n - 1);
+					}
+					op.row = k;
+					op.other_row = best;
+					_factors.do_rowop(op);
+					_switches.push_back(op);
+				}
+				//Pivots this small relative to the entries of
+				//their column are only rounding error, so the
+				//matrix is treated as singular (each column has
+				//its own scale, so a large column does not hide
+				//a small one)
+				T tolerance = 0;
+				for(size_t i = 0; i < n; i++) {
+					tolerance = max(tolerance, fabs(original[i * n + k]));
+				}
+				tolerance *= n * numeric_limits<T>::epsilon();
+				T pivot = entries[k * n + k];
+				if(fabs(pivot) <= tolerance) {
+					//The rest of the column is (nearly) zero
+					_invertible = false;
+				}
+				if(pivot == 0) {
+					//The rest of the column is already zero
+					continue;
+				}
+				const T* pivotrow = entries + k * n;
+				for(size_t i = k + 1; i < n; i++) {
+					T* row = entries + i * n;
+					T l = row[k] / pivot;
+					//Store the multiplier where the zero would be
+					row[k] = l;
+					if(l != 0) {
+						for(size_t j = k + 1; j < n; j++) {
+							row[j] -= l * pivotrow[j];
+						}
+					}
+				}
+			}
+			_factors._structure = structure_general;
+		}
+
+		template<class T>
+		size_t basic_lu<T>::size() const {
+			return _factors._rows;
+		}
+
+		template<class T>
+		const basic_matrix<T>& basic_lu<T>::factors() const {
+			return _factors;
+		}
+
+		template<class T>
+		const vector<rowop>& basic_lu<T>::switches() const {
+			return _switches;
+		}
+
+		template<class T>
+		bool basic_lu<T>::invertible() const {
+			return _invertible;
+		}
+
+		template<class T>
+		T basic_lu<T>::determinant() const {
+			//Product of the pivots, with the sign
+			//flipped for each row switch
+			size_t n = _factors._rows;
+			T det = (_switches.size() % 2 == 0) ? 1 : -1;
+			for(size_t i = 0; i < n; i++) {
+				det *= _factors._entries[i * n + i];
+			}
+			//A zero pivot gives 0, not -0
+			return (det == 0) ? 0 : det;
+		}
+
+		template<class T>
+		basic_matrix<T> basic_lu<T>::solve(const basic_matrix<T>& b) const {
+			basic_matrix<T> temp = b;
+			solve_in_place(temp);
+			return temp;
+		}
+
+		template<class T>
+		void basic_lu<T>::solve_in_place(basic_matrix<T>& b) const {
+			size_t n = _factors._rows;
+			if(b._rows != n) {
+				throw invalid_argument("Right-hand sides do not have the right number of rows");
+			}
+			if(!_invertible) {
+				throw logic_error("Matrix is not invertible");
+			}
+			b._unshare();
+			//Apply P, then solve LY = PB and UX = Y,
+			//updating whole rows of B at a time
+			for(size_t s = 0; s < _switches.size(); s++) {
+				b.do_rowop(_switches[s]);
+			}
+			size_t cols = b._cols;
+			const T* f = _factors._entries;
+			T* x = b._entries;
+			//Forward substitution with L (unit diagonal)
+			for(size_t i = 1; i < n; i++) {
+				T* row = x + i * cols;
+				for(size_t k = 0; k < i; k++) {
+					T l = f[i * n + k];
+					if(l != 0) {
+						const T* other = x + k * cols;
+						for(size_t j = 0; j < cols; j++) {
+							row[j] -= l * other[j];
+						}
+					}
+				}
+			}
+			//Back substitution with U
+			for(size_t i = n; i-- > 0; ) {
+				T* row = x + i * cols;
+				for(size_t k = i + 1; k < n; k++) {
+					T u = f[i * n + k];
+					if(u != 0) {
+						const T* other = x + k * cols;
+						for(size_t j = 0; j < cols; j++) {
+							row[j] -= u * other[j];
+						}
+					}
+				}
+				T pivot = f[i * n + i];
+				for(size_t j = 0; j < cols; j++) {
+					row[j] /= pivot;
+				}
+			}
+			b._structure = structure_general;
+		}
+
+		template<class T>
+		basic_matrix<T> basic_lu<T>::inverse() const {
+			//Solve AX = I
+			basic_matrix<T> temp(_factors._rows);
+			solve_in_place(temp);
+			return temp;
+		}
+
+		template class basic_lu<float>;
+		template class basic_lu<double>;
+	}
+}
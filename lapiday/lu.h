@@ -0,0 +1,129 @@
+#ifndef LAPIDAY_LU_H
+#define LAPIDAY_LU_H
+
+#include "matrix.h"
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+using std::size_t;
+using std::logic_error;
+using std::invalid_argument;
+using std::vector;
+
+namespace lapiday {
+	namespace matrix {
+		/**
+		* LU decomposition with partial pivoting of a square
+		* matrix A, so that PA = LU. Once created, it can be
+		* used to solve systems with A for any number of
+		* right-hand sides without repeating the elimination.
+		* Only float and double entries are supported; lu is
+		* the double version.
+		*/
+		template<class T>
+		class basic_lu {
+		public:
+			/**
+			* Decompose the given matrix. Runs in O(n^3) time.
+			* If a pivot is zero up to rounding error
+			* (relative to the largest entry in its column),
+			* the matrix is treated as not invertible.
+			* @param m Matrix to decompose
+			* @throw logic_error If the matrix is not square
+			*/
+			explicit basic_lu(const basic_matrix<T>& m);
+
+			/**
+			* Get the number of rows (and columns) of the
+			* decomposed matrix.
+			* @return Size
+			*/
+			size_t size() const;
+
+			/**
+			* Get L and U, stored in one matrix. The entries
+			* of U are on and above the diagonal, and the
+			* entries of L (whose diagonal entries are all 1)
+			* are below the diagonal.
+			* @return L and U
+			*/
+			const basic_matrix<T>& factors() const;
+
+			/**
+			* Get the row switches making up P, in the order
+			* they were applied.
+			* @return Row switches
+			*/
+			const vector<rowop>& switches() const;
+
+			/**
+			* Check if the decomposed matrix is invertible
+			* (all pivots are nonzero, up to rounding error).
+			* @return true if the matrix is invertible,
+			* false otherwise
+			*/
+			bool invertible() const;
+
+			/**
+			* Get the determinant of the decomposed matrix,
+			* the product of the pivots. Pivots that are
+			* only rounding error are not rounded to zero.
+			* @return Determinant
+			*/
+			T determinant() const;
+
+			/**
+			* Solve AX = B for X. Each column of B is a
+			* separate right-hand side, and all of them
+			* are solved together.
+			* @param b Right-hand sides
+			* @return Solutions, one per column
+			* @throw invalid_argument If B does not have
+			* as many rows as A
+			* @throw logic_error If A is not invertible
+			*/
+			basic_matrix<T> solve(const basic_matrix<T>& b) const;
+
+			/**
+			* Solve AX = B for X, replacing B with X.
+			* @param b Right-hand sides, replaced
+			* with the solutions
+			* @throw invalid_argument If B does not have
+			* as many rows as A
+			* @throw logic_error If A is not invertible
+			*/
+			void solve_in_place(basic_matrix<T>& b) const;
+
+			/**
+			* Find the inverse of the decomposed matrix.
+			* @return Inverse
+			* @throw logic_error If the matrix is not invertible
+			*/
+			basic_matrix<T> inverse() const;
+		private:
+			/**
+			* L and U, stored in one matrix
+			*/
+			basic_matrix<T> _factors;
+
+			/**
+			* Row switches making up P
+			*/
+			vector<rowop> _switches;
+
+			/**
+			* Whether or not all pivots are nonzero,
+			* up to rounding error
+			*/
+			bool _invertible;
+		};
+
+		/**
+		* LU decomposition of a matrix of doubles
+		*/
+		typedef basic_lu<double> lu;
+	}
+}
+
+#endif
@@ -1,110 +1,338 @@
 #include "matrix.h"
+#include "gemm.h"
+#include "lu.h"
+#include "view.h"
+#include "parallel.h"
 #include <cstddef>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include <atomic>
+#include <new>
 
 using std::size_t;
 using std::logic_error;
 using std::invalid_argument;
 using std::out_of_range;
 using std::ostream;
-using std::endl;
+using std::copy;
+using std::swap;
+using std::swap_ranges;
+using std::fabs;
+using std::max;
+using std::numeric_limits;
+using std::less;
+using std::atomic;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_acq_rel;
+using std::max_align_t;
+using std::bad_alloc;
 
 namespace lapiday {
 	namespace matrix {
-		matrix::matrix() {
+		/**
+		* Bytes before the entries of a heap array, holding
+		* the number of matrices that share the array
+		* (rounded up so the entries stay aligned)
+		*/
+		const size_t REFERENCES_SIZE = (sizeof(atomic<size_t>) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+		/**
+		* Allocate a heap array of entries, used by one matrix.
+		* @param count Number of entries
+		* @return First entry
+		* @throw bad_alloc If there is not enough memory
+		*/
+		template<class T>
+		T* allocate_entries(size_t count) {
+			if(count > (static_cast<size_t>(-1) - REFERENCES_SIZE) / sizeof(T)) {
+				throw bad_alloc();
+			}
+			char* block = static_cast<char*>(::operator new(REFERENCES_SIZE + count * sizeof(T)));
+			new(block) atomic<size_t>(1);
+			return reinterpret_cast<T*>(block + REFERENCES_SIZE);
+		}
+
+		/**
+		* Get the number of matrices that share a heap array.
+		* @param entries First entry of the array
+		* @return Reference count
+		*/
+		template<class T>
+		atomic<size_t>& references(T* entries) {
+			return *reinterpret_cast<atomic<size_t>*>(reinterpret_cast<char*>(entries) - REFERENCES_SIZE);
+		}
+
+		/**
+		* Stop using a heap array, and free it if no other
+		* matrix uses it.
+		* @param entries First entry of the array
+		*/
+		template<class T>
+		void release_entries(T* entries) {
+			//The other owners' reads must finish before
+			//the last owner frees the array
+			if(references(entries).fetch_sub(1, memory_order_acq_rel) == 1) {
+				::operator delete(reinterpret_cast<char*>(entries) - REFERENCES_SIZE);
+			}
+		}
+
+		/**
+		* Run a task on ranges of rows, split between the
+		* threads of the pool if there are enough entries.
+		* The task is only wrapped for the pool when it
+		* is used, so small matrices do not allocate.
+		* @param rows Number of rows
+		* @param cols Number of entries per row
+		* @param task Task taking the first row and one
+		* past the last row
+		*/
+		template<class F>
+		static void for_rows(size_t rows, size_t cols, F task) {
+			if(rows * cols >= parallel::PARALLEL_MIN_ENTRIES) {
+				parallel::for_ranges(rows, 1, task);
+			} else {
+				task(0, rows);
+			}
+		}
+
+		/**
+		* Check if a structure is affine or more specific
+		* (but not diagonal or identity, which are checked
+		* separately).
+		* @param s Structure
+		* @return true if s is affine, similarity or rigid,
+		* false otherwise
+		*/
+		static bool affine_family(structure_type s) {
+			return (s == structure_affine) || (s == structure_similarity) || (s == structure_rigid);
+		}
+
+		/**
+		* Get the structure of a product of two matrices
+		* from the affine family.
+		* @param first Structure of the first factor
+		* @param second Structure of the second factor
+		* @return Structure of the product
+		*/
+		static structure_type affine_product_structure(structure_type first, structure_type second) {
+			if((first == structure_rigid) && (second == structure_rigid)) {
+				return structure_rigid;
+			} else if((first != structure_affine) && (second != structure_affine)) {
+				return structure_similarity;
+			} else {
+				return structure_affine;
+			}
+		}
+
+		/**
+		* Check if a view has any entries in the given array.
+		* @param v View
+		* @param entries Array
+		* @param count Number of entries in the array
+		* @return true if the view may share entries with
+		* the array, false otherwise
+		*/
+		template<class T>
+		static bool overlaps(const basic_const_matrix_view<T>& v, const T* entries, size_t count) {
+			if((v.rows() == 0) || (v.cols() == 0) || (count == 0)) {
+				return false;
+			}
+			//Pointers into different arrays can only be
+			//compared in order with less
+			const T* first = v.data();
+			const T* last = first + (v.rows() - 1) * v.row_stride() + (v.cols() - 1) * v.col_stride();
+			less<const T*> before;
+			return !before(last, entries) && before(first, entries + count);
+		}
+
+		template<class T>
+		basic_matrix<T>::basic_matrix() {
 			_entries = NULL;
+			_copy_on_write = false;
 			_allocate(0, 0);
+			_structure = structure_general;
 		}
 
-		matrix::matrix(size_t rows, size_t cols) {
+		template<class T>
+		basic_matrix<T>::basic_matrix(size_t rows, size_t cols) {
 			_entries = NULL;
+			_copy_on_write = false;
 			_allocate(rows, cols);
 			if((_rows > 0) && (_cols > 0)) {
 				for(size_t i = 0; i < _rows; i++) {
 					for(size_t j = 0; j < _cols; j++) {
-						_entries[i][j] = 0;
+						_entries[i * _cols + j] = 0;
 					}
 				}
 			}
+			//A square zero matrix is diagonal
+			_structure = square() ? structure_diagonal : structure_general;
 		}
 
-		matrix::matrix(size_t size) {
+		template<class T>
+		basic_matrix<T>::basic_matrix(size_t size) {
 			_entries = NULL;
+			_copy_on_write = false;
 			_allocate(size, size);
 			_make_identity();
 		}
 
-		matrix::matrix(size_t size, rowop op) {
+		template<class T>
+		basic_matrix<T>::basic_matrix(size_t size, rowop op) {
 			_entries = NULL;
+			_copy_on_write = false;
 			_allocate(size, size);
 			_make_identity();
 			do_rowop(op);
+			_structure = structure_general;
 		}
 
-		matrix::matrix(const matrix& m) {
+		template<class T>
+		basic_matrix<T>::basic_matrix(const basic_matrix& m) {
 			_entries = NULL;
+			_copy_on_write = m._copy_on_write;
 			_copy_data(m);
 		}
 
-		matrix::~matrix() {
+		template<class T>
+		basic_matrix<T>::basic_matrix(basic_matrix&& m) {
+			_entries = NULL;
+			_rows = 0;
+			_cols = 0;
+			_structure = structure_general;
+			_copy_on_write = m._copy_on_write;
+			_swap(m);
+		}
+
+		template<class T>
+		basic_matrix<T>::basic_matrix(const basic_const_matrix_view<T>& v) {
+			_entries = NULL;
+			_copy_on_write = false;
+			_allocate(v.rows(), v.cols());
+			basic_matrix_view<T>(_entries, _rows, _cols, _cols, 1).assign(v);
+			_structure = structure_general;
+		}
+
+		template<class T>
+		basic_matrix<T>::~basic_matrix() {
 			_deallocate_entries();
 		}
 
-		size_t matrix::rows() const {
+		template<class T>
+		size_t basic_matrix<T>::rows() const {
 			return _rows;
 		}
 
-		size_t matrix::cols() const {
+		template<class T>
+		size_t basic_matrix<T>::cols() const {
 			return _cols;
 		}
 
-		bool matrix::square() const {
+		template<class T>
+		bool basic_matrix<T>::square() const {
 			return (_rows == _cols);
 		}
 
-		matrix matrix::transpose() const {
-			matrix temp(_cols, _rows);
-			for(size_t i = 0; i < _rows; i++) {
-				for(size_t j = 0; j < _cols; j++) {
-					temp._entries[j][i] = _entries[i][j];
+		template<class T>
+		structure_type basic_matrix<T>::structure() const {
+			return _structure;
+		}
+
+		template<class T>
+		void basic_matrix<T>::detect_structure() {
+			if(_has_structure(structure_identity)) {
+				_structure = structure_identity;
+			} else if(_has_structure(structure_diagonal)) {
+				_structure = structure_diagonal;
+			} else if(_has_structure(structure_affine)) {
+				_structure = structure_affine;
+			} else {
+				_structure = structure_general;
+			}
+		}
+
+		template<class T>
+		void basic_matrix<T>::assume_structure(structure_type s) {
+			if(!_has_structure(s)) {
+				throw invalid_argument("Matrix does not have the given structure");
+			}
+			_structure = s;
+		}
+
+		template<class T>
+		bool basic_matrix<T>::copy_on_write() const {
+			return _copy_on_write;
+		}
+
+		template<class T>
+		void basic_matrix<T>::set_copy_on_write(bool enabled) {
+			_copy_on_write = enabled;
+		}
+
+		template<class T>
+		basic_matrix<T> basic_matrix<T>::transpose() const {
+			basic_matrix temp(_cols, _rows);
+			size_t rows = _rows;
+			size_t cols = _cols;
+			const T* entries = _entries;
+			T* out = temp._entries;
+			//Split by rows of the transpose, so that each
+			//thread writes its own part
+			for_rows(cols, rows, [=](size_t begin, size_t end) {
+				for(size_t j = begin; j < end; j++) {
+					for(size_t i = 0; i < rows; i++) {
+						out[j * rows + i] = entries[i * cols + j];
+					}
 				}
+			});
+			//Transposing keeps a matrix diagonal, but
+			//moves the last row of an affine matrix
+			if((_structure == structure_identity) || (_structure == structure_diagonal)) {
+				temp._structure = _structure;
+			} else {
+				temp._structure = structure_general;
 			}
 			return temp;
 		}
 
-		bool matrix::symmetric() const {
+		template<class T>
+		bool basic_matrix<T>::symmetric() const {
 			if(!square()) {
 				return false;
 			}
 			return (*this == transpose());
 		}
 
-		bool matrix::same_size(const matrix& m) const {
+		template<class T>
+		bool basic_matrix<T>::same_size(const basic_matrix& m) const {
 			return ((_rows == m._rows) && (_cols == m._cols));
 		}
 
-		void matrix::do_rowop(rowop op) {
+		template<class T>
+		void basic_matrix<T>::do_rowop(rowop op) {
 			//Check row
 			if(op.row >= _rows) {
 				throw invalid_argument("Row out of range");
 			}
+			_unshare();
 			switch(op.type) {
 			case rowop_switch:
 				//Check other row
 				if(op.other_row >= _rows) {
 					throw invalid_argument("Other row out of range");
 				}
-				{
-					//Switch the pointers to the rows
-					double* temp = _entries[op.row];
-					_entries[op.row] = _entries[op.other_row];
-					_entries[op.other_row] = temp;
-				}
+				//Switch the entries of the rows
+				swap_ranges(_entries + op.row * _cols, _entries + (op.row + 1) * _cols, _entries + op.other_row * _cols);
 				break;
 			case rowop_multiply:
 				for(size_t i = 0; i < _cols; i++) {
-					_entries[op.row][i] *= op.multiplier;
+					_entries[op.row * _cols + i] *= op.multiplier;
 				}
 				break;
 			case rowop_add:
@@ -113,17 +341,93 @@ namespace lapiday {
 					throw invalid_argument("Other row out of range");
 				}
 				for(size_t i = 0; i < _cols; i++) {
-					_entries[op.row][i] += (op.multiplier * _entries[op.other_row][i]);
+					_entries[op.row * _cols + i] += (op.multiplier * _entries[op.other_row * _cols + i]);
 				}
 				break;
 			}
+			_structure = structure_general;
 		}
 
-		void matrix::gauss_jordan() {
-			//NOT IMPLEMENTED
+		template<class T>
+		void basic_matrix<T>::gauss_jordan() {
+			_unshare();
+			rowop op;
+			size_t pivotrow = 0;
+			//The pivot rows are only divided by their pivots
+			//at the end, so every column keeps the scale of
+			//its original entries and its tolerance can be
+			//found from its current entries
+			for(size_t col = 0; (col < _cols) && (pivotrow < _rows); col++) {
+				//Use the largest entry in the column as the pivot
+				size_t best = pivotrow;
+				for(size_t i = pivotrow + 1; i < _rows; i++) {
+					if(fabs(_entries[i * _cols + col]) > fabs(_entries[best * _cols + col])) {
+						best = i;
+					}
+				}
+				T pivot = _entries[best * _cols + col];
+				//Pivots this small relative to the entries of
+				//their column are only rounding error, so treat
+				//them as zero
+				T tolerance = 0;
+				for(size_t i = 0; i < _rows; i++) {
+					tolerance = max(tolerance, fabs(_entries[i * _cols + col]));
+				}
+				tolerance *= max(_rows, _cols) * numeric_limits<T>::epsilon();
+				if(fabs(pivot) <= tolerance) {
+					//No pivot in this column, so what
+					//remains of it is rounding error
+					for(size_t i = pivotrow; i < _rows; i++) {
+						_entries[i * _cols + col] = 0;
+					}
+					continue;
+				}
+				if(best != pivotrow) {
+					op.type = rowop_switch;
+					op.row = pivotrow;
+					op.other_row = best;
+					do_rowop(op);
+				}
+				//Clear the rest of the column
+				op.type = rowop_add;
+				op.other_row = pivotrow;
+				for(size_t i = 0; i < _rows; i++) {
+					if((i != pivotrow) && (_entries[i * _cols + col] != 0)) {
+						op.row = i;
+						op.multiplier = -_entries[i * _cols + col] / pivot;
+						do_rowop(op);
+						//Avoid rounding error in the cleared entry
+						_entries[i * _cols + col] = 0;
+					}
+				}
+				pivotrow++;
+			}
+			//Entries left of each pivot are now zero, so the
+			//first nonzero entry of each row is its pivot
+			op.type = rowop_multiply;
+			for(size_t i = 0; i < pivotrow; i++) {
+				size_t col = 0;
+				while(_entries[i * _cols + col] == 0) {
+					col++;
+				}
+				op.row = i;
+				op.multiplier = 1 / _entries[i * _cols + col];
+				do_rowop(op);
+				//Avoid rounding error in the pivot itself
+				_entries[i * _cols + col] = 1;
+			}
+			//Scaling zeros by a negative pivot leaves -0,
+			//which should print as 0
+			size_t count = _rows * _cols;
+			for(size_t i = 0; i < count; i++) {
+				if(_entries[i] == 0) {
+					_entries[i] = 0;
+				}
+			}
 		}
 
-		double matrix::determinant() const {
+		template<class T>
+		T basic_matrix<T>::determinant() const {
 			if(!square()) {
 				throw logic_error("Matrix is not square");
 			}
@@ -131,155 +435,119 @@ namespace lapiday {
 				//The determinant of an empty matrix is 1
 				return 1;
 			}
-			return 0; //NOT IMPLEMENTED
+			return basic_lu<T>(*this).determinant();
 		}
 
-		bool matrix::invertible() const {
+		template<class T>
+		bool basic_matrix<T>::invertible() const {
 			if(!square()) {
 				return false;
 			} else {
-				return (determinant() != 0);
+				//Check the pivots instead of the determinant,
+				//which can underflow to 0 for large matrices
+				return basic_lu<T>(*this).invertible();
 			}
 		}
 
-		matrix matrix::inverse() const {
-			matrix temp = *this;
+		template<class T>
+		basic_matrix<T> basic_matrix<T>::inverse() const {
+			basic_matrix temp = *this;
 			temp._invert();
 			return temp;
 		}
 
-		matrix matrix::adjoint() const {
+		template<class T>
+		basic_matrix<T> basic_matrix<T>::adjoint() const {
 			if(!square()) {
 				throw logic_error("Matrix is not square");
 			}
-			matrix temp(_cols, _rows);
+			basic_lu<T> decomposition(*this);
+			if(decomposition.invertible()) {
+				//adj(A) = det(A) * inverse(A), found in O(n^3)
+				//instead of with n^2 determinants
+				basic_matrix temp = decomposition.inverse();
+				temp._multiply(decomposition.determinant());
+				return temp;
+			}
+			//Reuse one matrix for all of the submatrices
+			basic_matrix temp(_cols, _rows);
+			basic_matrix minor(_rows - 1, _cols - 1);
 			for(size_t i = 0; i < _rows; i++) {
 				for(size_t j = 0; j < _cols; j++) {
-					temp._entries[j][i] = submatrix(i, j).determinant();
+					_copy_submatrix(i, j, minor);
+					temp._entries[j * temp._cols + i] = minor.determinant();
 					if((i + j) % 2 == 1) {
-						temp._entries[j][i] = -temp._entries[j][i];
+						temp._entries[j * temp._cols + i] = -temp._entries[j * temp._cols + i];
 					}
 				}
 			}
+			temp._structure = structure_general;
 			return temp;
 		}
 
-		matrix matrix::submatrix(size_t i, size_t j) const {
-			//"Normalize" zero dimensions to one
-			//so the "dimension minus one" works
-			size_t normrows = _rows ? _rows : 1;
-			size_t normcols = _cols ? _cols : 1;
-			matrix temp(normrows - 1, normcols - 1);
-			size_t newrow = 0;
-			size_t newcol;
-			//Use original dimensions in loop
-			for(size_t oldrow = 0; oldrow < _rows; oldrow++) {
-				if(newrow == i) {
-					//Skip row
-					oldrow++;
-				}
-				newcol = 0;
-				for(size_t oldcol = 0; oldcol < _cols; oldcol++) {
-					if(newcol == j) {
-						//Skip column
-						oldcol++;
-					}
-					temp._entries[newrow][newcol] = _entries[oldrow][oldcol];
-					newcol++;
-				}
-				newrow++;
+		template<class T>
+		basic_matrix<T> basic_matrix<T>::submatrix(size_t i, size_t j) const {
+			if((i >= _rows) || (j >= _cols)) {
+				throw invalid_argument("Row or column out of range");
 			}
+			basic_matrix temp(_rows - 1, _cols - 1);
+			_copy_submatrix(i, j, temp);
 			return temp;
 		}
 
-		double& matrix::operator()(size_t i, size_t j) {
+		template<class T>
+		basic_const_matrix_view<T> basic_matrix<T>::view() const {
+			return basic_const_matrix_view<T>(_entries, _rows, _cols, _cols, 1);
+		}
+
+		template<class T>
+		basic_matrix_view<T> basic_matrix<T>::view() {
+			//The entries may be changed through the view
+			_unshare();
+			_structure = structure_general;
+			return basic_matrix_view<T>(_entries, _rows, _cols, _cols, 1);
+		}
+
+		template<class T>
+		T& basic_matrix<T>::operator()(size_t i, size_t j) {
 			if((i < _rows) && (j < _cols)) {
-				return _entries[i][j];
+				//The entry may be changed through the reference
+				_unshare();
+				_structure = structure_general;
+				return _entries[i * _cols + j];
 			} else {
 				throw out_of_range("Element index out of range");
 			}
 		}
 
-		double matrix::operator()(size_t i, size_t j) const {
+		template<class T>
+		T basic_matrix<T>::operator()(size_t i, size_t j) const {
 			if((i < _rows) && (j < _cols)) {
-				return _entries[i][j];
+				return _entries[i * _cols + j];
 			} else {
 				throw out_of_range("Element index out of range");
 			}
 		}
 
-		bool operator ==(const matrix& first, const matrix& second) {
-			if(!first.same_size(second)) {
-				//Different sizes
-				return false;
-			}
-			//Check entries
-			size_t rows = first._rows;
-			size_t cols = first._cols;
-			for(size_t i = 0; i < rows; i++) {
-				for(size_t j = 0; j < cols; j++) {
-					if(first._entries[i][j] != second._entries[i][j]) {
-						return false;
-					}
-				}
-			}
-			//Did not return in loop
-			return true;
-		}
-
-		bool operator !=(const matrix& first, const matrix& second) {
-			return !(first == second);
-		}
-
-		matrix operator +(const matrix& first, const matrix& second) {
-			if(!first.same_size(second)) {
-				throw invalid_argument("Matrices are not the same size");
-			}
-			matrix temp = first;
-			temp._add(second);
-			return temp;
-		}
-
-		matrix& matrix::operator +=(const matrix& m) {
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator +=(const basic_matrix& m) {
 			_add(m);
 			return *this;
 		}
 
-		matrix operator -(const matrix& min, const matrix& sub) {
-			return (min + (-sub));
-		}
-
-		matrix& matrix::operator -=(const matrix& m) {
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator -=(const basic_matrix& m) {
 			return operator +=(-m);
 		}
 
-		matrix operator *(double scalar, const matrix& m) {
-			matrix temp = m;
-			temp._multiply(scalar);
-			return temp;
-		}
-
-		matrix operator *(const matrix& m, double scalar) {
-			matrix temp = m;
-			temp._multiply(scalar);
-			return temp;
-		}
-
-		matrix& matrix::operator *=(double scalar) {
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator *=(T scalar) {
 			_multiply(scalar);
 			return *this;
 		}
 
-		matrix operator /(const matrix& m, double scalar) {
-			if(scalar == 0) {
-				throw invalid_argument("Division by zero scalar");
-			}
-			matrix temp = m;
-			temp._multiply(1 / scalar);
-			return temp;
-		}
-
-		matrix& matrix::operator /=(double scalar) {
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator /=(T scalar) {
 			if(scalar == 0) {
 				throw invalid_argument("Division by zero scalar");
 			}
@@ -287,182 +555,594 @@ namespace lapiday {
 			return *this;
 		}
 
-		matrix matrix::operator -() const {
-			matrix temp = *this;
+		template<class T>
+		basic_matrix<T> basic_matrix<T>::operator -() const {
+			basic_matrix temp = *this;
 			temp._multiply(-1);
 			return temp;
 		}
 
-		matrix operator *(const matrix& first, const matrix& second) {
-			matrix temp = first;
-			temp._multiply(second);
-			return temp;
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator *=(const basic_matrix& m) {
+			_multiply(m);
+			return *this;
 		}
 
-		matrix& matrix::operator *=(const matrix& m) {
-			_multiply(m);
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator ^=(int exp) {
+			_power(exp);
 			return *this;
 		}
 
-		matrix operator ^(const matrix& m, int exp) {
-			if(!m.square()) {
-				throw invalid_argument("Matrix is not square");
-			}
-			if(exp == 0) {
-				//Return identity matrix
-				return matrix(m._rows);
-			} else {
-				matrix temp;
-				if(exp < 0) {
-					//Check invertibility
-					if(!m.invertible()) {
-						throw invalid_argument("Matrix is not invertible");
-					}
-					exp = -exp;
-					temp = m.inverse();
-				} else {
-					temp = m;
-				}
-				//_multiply(matrix) takes a reference,
-				//so another copy is needed
-				matrix temp2 = temp;
-				for(int i = 0; i < exp; i++) {
-					temp._multiply(temp2);
-				}
-				return temp;
-			}
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator =(const basic_matrix& m) {
+			if(this != &m) {
+				_copy_data(m);
+			} //else self-assignment: Do nothing
+			return *this;
 		}
 
-		matrix& matrix::operator ^=(int exp) {
-			if(!square()) {
-				throw invalid_argument("Matrix is not square");
-			}
-			if(exp == 0) {
-				//Identity matrix
-				_make_identity();
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator =(basic_matrix&& m) {
+			_swap(m);
+			return *this;
+		}
+
+		template<class T>
+		basic_matrix<T>& basic_matrix<T>::operator =(const basic_const_matrix_view<T>& v) {
+			if(overlaps(v, _entries, _rows * _cols)) {
+				//Copy first, since the array may be reused
+				basic_matrix temp(v);
+				_swap(temp);
 			} else {
-				if(exp < 0) {
-					_invert();
-					exp = -exp;
-				}
-				//_multiply(matrix) takes a reference,
-				//so a copy is needed
-				matrix temp = *this;
-				for(int i = 0; i < exp; i++) {
-					_multiply(temp);
-				}
+				_allocate(v.rows(), v.cols());
+				basic_matrix_view<T>(_entries, _rows, _cols, _cols, 1).assign(v);
+				_structure = structure_general;
 			}
 			return *this;
 		}
 
-		matrix& matrix::operator =(const matrix& m) {
-			if(this != &m) {
-				_copy_data(m);
-			} //else self-assignment: Do nothing
-			return *this;
+		template<class T>
+		bool basic_matrix<T>::_equals(const basic_matrix& m) const {
+			if(!same_size(m)) {
+				//Different sizes
+				return false;
+			}
+			if(_entries == m._entries) {
+				//Shared entries
+				return true;
+			}
+			//Check entries
+			for(size_t i = 0; i < _rows; i++) {
+				for(size_t j = 0; j < _cols; j++) {
+					if(_entries[i * _cols + j] != m._entries[i * _cols + j]) {
+						return false;
+					}
+				}
+			}
+			//Did not return in loop
+			return true;
 		}
 
-		ostream& operator <<(ostream& out, const matrix& m) {
-			if((m._rows > 0) && (m._cols > 0)) {
-				for(size_t i = 0; i < m._rows; i++) {
-					out << m._entries[i][0];
-					for(size_t j = 1; j < m._cols; j++) {
-						out << ", " << m._entries[i][j];
+		template<class T>
+		void basic_matrix<T>::_write(ostream& out) const {
+			if((_rows > 0) && (_cols > 0)) {
+				for(size_t i = 0; i < _rows; i++) {
+					out << _entries[i * _cols];
+					for(size_t j = 1; j < _cols; j++) {
+						out << ", " << _entries[i * _cols + j];
 					}
-					out << endl;
+					//Not endl, which would flush every row
+					out << '\n';
 				}
 			} else {
-				out << "[]" << endl;
+				out << "[]\n";
 			}
-			return out;
 		}
 
-		void matrix::_allocate(size_t rows, size_t cols) {
-			_deallocate_entries();
-			//Allocate row pointers
-			_entries = new double*[rows];
-			//Allocate each row
-			for(size_t i = 0; i < rows; i++) {
-				_entries[i] = new double[cols];
+		template<class T>
+		void basic_matrix<T>::_multiply_views(const basic_const_matrix_view<T>& first, const basic_const_matrix_view<T>& second, basic_matrix& out) {
+			if(first.cols() != second.rows()) {
+				throw invalid_argument("Matrices cannot be multiplied in the given order");
 			}
+			size_t count = out._rows * out._cols;
+			if(overlaps(first, out._entries, count) || overlaps(second, out._entries, count)) {
+				basic_matrix temp;
+				_multiply_views(first, second, temp);
+				out._swap(temp);
+				return;
+			}
+			out._allocate(first.rows(), second.cols());
+			gemm::multiply_strided(first.data(), first.row_stride(), first.col_stride(), second.data(), second.row_stride(), second.col_stride(), out._entries, first.rows(), first.cols(), second.cols());
+			out._structure = structure_general;
+		}
+
+		template<class T>
+		void basic_matrix<T>::_allocate(size_t rows, size_t cols) {
+			size_t count = rows * cols;
+			if((_entries == NULL) || (count != _rows * _cols) || _shared()) {
+				_deallocate_entries();
+				if(count > INLINE_CAPACITY) {
+					_entries = allocate_entries<T>(count);
+				} else if(count > 0) {
+					_entries = _inline;
+				}
+			} //else the old array can be reused
 			//Set members
 			_rows = rows;
 			_cols = cols;
 		}
 
-		void matrix::_deallocate_entries() {
-			if(_entries != NULL) {
-				//Deallocate each row
-				for(size_t i = 0; i < _rows; i++) {
-					delete[] _entries[i];
+		template<class T>
+		void basic_matrix<T>::_deallocate_entries() {
+			if((_entries != NULL) && (_entries != _inline)) {
+				release_entries(_entries);
+			}
+			_entries = NULL;
+		}
+
+		template<class T>
+		bool basic_matrix<T>::_shared() const {
+			if((_entries == NULL) || (_entries == _inline)) {
+				return false;
+			}
+			//Acquire so that writes after this check come
+			//after the reads of owners that released the array
+			return references(_entries).load(memory_order_acquire) > 1;
+		}
+
+		template<class T>
+		void basic_matrix<T>::_unshare() {
+			if(_shared()) {
+				size_t count = _rows * _cols;
+				T* entries = allocate_entries<T>(count);
+				copy(_entries, _entries + count, entries);
+				release_entries(_entries);
+				_entries = entries;
+			}
+		}
+
+		template<class T>
+		void basic_matrix<T>::_copy_data(const basic_matrix& m) {
+			if(m._copy_on_write && (m._entries != NULL) && (m._entries != m._inline)) {
+				//Take a reference before releasing the old
+				//array, in case it is the same array
+				references(m._entries).fetch_add(1, memory_order_relaxed);
+				_deallocate_entries();
+				_entries = m._entries;
+				_rows = m._rows;
+				_cols = m._cols;
+			} else {
+				_allocate(m._rows, m._cols);
+				copy(m._entries, m._entries + (m._rows * m._cols), _entries);
+			}
+			_structure = m._structure;
+		}
+
+		template<class T>
+		void basic_matrix<T>::_swap(basic_matrix& m) {
+			bool is_inline = (_entries == _inline);
+			bool other_inline = (m._entries == m._inline);
+			if(is_inline || other_inline) {
+				//Inline entries cannot change owner, so copy them
+				T temp[INLINE_CAPACITY];
+				size_t count = _rows * _cols;
+				T* entries = _entries;
+				if(is_inline) {
+					copy(_inline, _inline + count, temp);
+				}
+				if(other_inline) {
+					copy(m._inline, m._inline + (m._rows * m._cols), _inline);
+					_entries = _inline;
+				} else {
+					_entries = m._entries;
 				}
-				//Deallocate row pointers
-				delete[] _entries;
+				if(is_inline) {
+					copy(temp, temp + count, m._inline);
+					m._entries = m._inline;
+				} else {
+					m._entries = entries;
+				}
+			} else {
+				swap(_entries, m._entries);
 			}
+			swap(_rows, m._rows);
+			swap(_cols, m._cols);
+			swap(_structure, m._structure);
 		}
 
-		void matrix::_copy_data(const matrix& m) {
-			_allocate(m._rows, m._cols);
-			for(size_t i = 0; i < _rows; i++) {
-				for(size_t j = 0; j < _cols; j++) {
-					_entries[i][j] = m._entries[i][j];
+		template<class T>
+		void basic_matrix<T>::_copy_submatrix(size_t i, size_t j, basic_matrix& out) const {
+			//Copy the four blocks around the deleted
+			//row and column
+			basic_const_matrix_view<T> source = view();
+			basic_matrix_view<T> target = out.view();
+			size_t below = _rows - 1 - i;
+			size_t right = _cols - 1 - j;
+			target.block(0, 0, i, j).assign(source.block(0, 0, i, j));
+			target.block(0, j, i, right).assign(source.block(0, j + 1, i, right));
+			target.block(i, 0, below, j).assign(source.block(i + 1, 0, below, j));
+			target.block(i, j, below, right).assign(source.block(i + 1, j + 1, below, right));
+		}
+
+		template<class T>
+		bool basic_matrix<T>::_has_structure(structure_type s) const {
+			if(s == structure_general) {
+				return true;
+			}
+			if(!square()) {
+				return false;
+			}
+			size_t n = _rows;
+			switch(s) {
+			case structure_identity:
+			case structure_diagonal:
+				for(size_t i = 0; i < n; i++) {
+					for(size_t j = 0; j < n; j++) {
+						T entry = _entries[i * n + j];
+						if(i == j) {
+							if((s == structure_identity) && (entry != 1)) {
+								return false;
+							}
+						} else if(entry != 0) {
+							return false;
+						}
+					}
+				}
+				return true;
+			case structure_affine:
+			case structure_similarity:
+			case structure_rigid:
+				{
+					if(n == 0) {
+						return false;
+					}
+					const T* last = _entries + (n - 1) * n;
+					for(size_t j = 0; j + 1 < n; j++) {
+						if(last[j] != 0) {
+							return false;
+						}
+					}
+					if(last[n - 1] != 1) {
+						return false;
+					}
+					if(s == structure_affine) {
+						return true;
+					}
+					//The columns of the linear part must be
+					//orthogonal and the same length, up to
+					//rounding error
+					size_t m = n - 1;
+					T scale = 0;
+					for(size_t k = 0; k < m; k++) {
+						scale += _entries[k * n] * _entries[k * n];
+					}
+					if((m > 0) && (scale == 0)) {
+						return false;
+					}
+					T tolerance = 16 * n * numeric_limits<T>::epsilon() * max(scale, T(1));
+					for(size_t i = 0; i < m; i++) {
+						for(size_t j = i; j < m; j++) {
+							T dot = 0;
+							for(size_t k = 0; k < m; k++) {
+								dot += _entries[k * n + i] * _entries[k * n + j];
+							}
+							T expected = (i == j) ? scale : 0;
+							if(fabs(dot - expected) > tolerance) {
+								return false;
+							}
+						}
+					}
+					if((s == structure_rigid) && (m > 0) && (fabs(scale - 1) > tolerance)) {
+						return false;
+					}
+					return true;
 				}
+			default:
+				return false;
 			}
 		}
 
-		void matrix::_make_identity() {
+		template<class T>
+		void basic_matrix<T>::_make_identity() {
 			if(_rows == _cols) {
 				for(size_t i = 0; i < _rows; i++) {
 					for(size_t j = 0; j < _cols; j++) {
 						if(i == j) {
-							_entries[i][j] = 1;
+							_entries[i * _cols + j] = 1;
 						} else {
-							_entries[i][j] = 0;
+							_entries[i * _cols + j] = 0;
 						}
 					}
 				}
+				_structure = structure_identity;
 			} //else not square: do nothing
 		}
 
-		void matrix::_add(const matrix& m) {
+		template<class T>
+		void basic_matrix<T>::_add(const basic_matrix& m) {
 			if(!same_size(m)) {
 				throw invalid_argument("Matrices are not the same size");
 			}
-			for(size_t i = 0; i < _rows; i++) {
-				for(size_t j = 0; j < _cols; j++) {
-					_entries[i][j] += m._entries[i][j];
+			_unshare();
+			size_t cols = _cols;
+			T* entries = _entries;
+			const T* other = m._entries;
+			for_rows(_rows, cols, [=](size_t begin, size_t end) {
+				for(size_t i = begin * cols; i < end * cols; i++) {
+					entries[i] += other[i];
 				}
-			}
+			});
+			//Only a sum of diagonal matrices is known to
+			//keep its structure
+			bool diagonal = ((_structure == structure_identity) || (_structure == structure_diagonal))
+				&& ((m._structure == structure_identity) || (m._structure == structure_diagonal));
+			_structure = diagonal ? structure_diagonal : structure_general;
 		}
 
-		void matrix::_multiply(double scalar) {
-			for(size_t i = 0; i < _rows; i++) {
-				for(size_t j = 0; j < _cols; j++) {
-					_entries[i][j] *= scalar;
+		template<class T>
+		void basic_matrix<T>::_multiply(T scalar) {
+			_unshare();
+			size_t cols = _cols;
+			T* entries = _entries;
+			for_rows(_rows, cols, [=](size_t begin, size_t end) {
+				for(size_t i = begin * cols; i < end * cols; i++) {
+					entries[i] *= scalar;
 				}
+			});
+			//Scaling changes the last row of an affine matrix
+			if(_structure == structure_identity) {
+				_structure = (scalar == 1) ? structure_identity : structure_diagonal;
+			} else if(_structure != structure_diagonal) {
+				_structure = structure_general;
 			}
 		}
 
-		void matrix::_multiply(const matrix& m) {
-			if(_cols != m._rows) {
+		template<class T>
+		void basic_matrix<T>::_multiply(const basic_matrix& m) {
+			basic_matrix temp;
+			_multiply_into(*this, m, temp);
+			_swap(temp);
+		}
+
+		template<class T>
+		void basic_matrix<T>::_multiply_into(const basic_matrix& first, const basic_matrix& second, basic_matrix& out) {
+			if(first._cols != second._rows) {
 				throw invalid_argument("Matrices cannot be multiplied in the given order");
 			}
-			matrix temp(_rows, m._cols);
-			double entry;
-			for(size_t i = 0; i < _rows; i++) {
-				for(size_t j = 0; j < m._cols; j++) {
-					entry = 0;
-					for(size_t k = 0; k < _cols; k++) {
-						entry += (_entries[i][k] * m._entries[k][j]);
+			if(_multiply_structured(first, second, out)) {
+				return;
+			}
+			out._allocate(first._rows, second._cols);
+			//Small products use a plain loop, large ones a blocked kernel
+			gemm::multiply(first._entries, second._entries, out._entries, first._rows, first._cols, second._cols);
+			out._structure = structure_general;
+		}
+
+		template<class T>
+		bool basic_matrix<T>::_multiply_structured(const basic_matrix& first, const basic_matrix& second, basic_matrix& out) {
+			structure_type left = first._structure;
+			structure_type right = second._structure;
+			size_t rows = first._rows;
+			size_t inner = first._cols;
+			size_t cols = second._cols;
+			if(left == structure_identity) {
+				out._copy_data(second);
+				return true;
+			}
+			if(right == structure_identity) {
+				out._copy_data(first);
+				return true;
+			}
+			if(left == structure_diagonal) {
+				//Scale each row of the second factor
+				out._allocate(rows, cols);
+				const T* diagonal = first._entries;
+				const T* entries = second._entries;
+				T* product = out._entries;
+				for_rows(rows, cols, [=](size_t begin, size_t end) {
+					for(size_t i = begin; i < end; i++) {
+						T d = diagonal[i * inner + i];
+						for(size_t j = 0; j < cols; j++) {
+							product[i * cols + j] = d * entries[i * cols + j];
+						}
+					}
+				});
+				out._structure = (right == structure_diagonal) ? structure_diagonal : structure_general;
+				return true;
+			}
+			if(right == structure_diagonal) {
+				//Scale each column of the first factor
+				out._allocate(rows, cols);
+				const T* entries = first._entries;
+				const T* diagonal = second._entries;
+				T* product = out._entries;
+				for_rows(rows, cols, [=](size_t begin, size_t end) {
+					for(size_t i = begin; i < end; i++) {
+						for(size_t j = 0; j < cols; j++) {
+							product[i * cols + j] = entries[i * inner + j] * diagonal[j * cols + j];
+						}
+					}
+				});
+				out._structure = structure_general;
+				return true;
+			}
+			if(!affine_family(left)) {
+				return false;
+			}
+			out._allocate(rows, cols);
+			size_t last = rows - 1;
+			if(last * inner * cols >= gemm::BLOCKED_MIN_WORK) {
+				//Leaving out one row or inner index saves too
+				//little to make up for the blocked kernel
+				//working on an odd shape, so only the
+				//structure of the result is kept
+				gemm::multiply(first._entries, second._entries, out._entries, rows, inner, cols);
+			} else if(!affine_family(right)) {
+				gemm::multiply(first._entries, second._entries, out._entries, last, inner, cols);
+			} else {
+				//The last row of the second factor is
+				//(0, ..., 0, 1) too, so the last inner index
+				//only adds the translation
+				for(size_t i = 0; i < last; i++) {
+					const T* row = first._entries + i * inner;
+					for(size_t j = 0; j < cols; j++) {
+						T entry = 0;
+						for(size_t k = 0; k < last; k++) {
+							entry += (row[k] * second._entries[k * cols + j]);
+						}
+						if(j == last) {
+							entry += row[last];
+						}
+						out._entries[i * cols + j] = entry;
 					}
-					temp._entries[i][j] = entry;
 				}
 			}
-			_copy_data(temp);
+			//The last row of the first factor is (0, ..., 0, 1),
+			//so the last row of the product is just the last row
+			//of the second factor (copied even when it was
+			//multiplied out, as 0 times an infinite entry is
+			//not 0)
+			for(size_t j = 0; j < cols; j++) {
+				out._entries[last * cols + j] = second._entries[last * cols + j];
+			}
+			if(affine_family(right)) {
+				out._structure = affine_product_structure(left, right);
+			} else {
+				out._structure = structure_general;
+			}
+			return true;
+		}
+
+		template<class T>
+		void basic_matrix<T>::_assign_product(const basic_matrix* const* factors, size_t count) {
+			//If this matrix is a factor, it cannot hold
+			//partial products until the end
+			bool aliased = false;
+			for(size_t i = 0; i < count; i++) {
+				if(factors[i] == this) {
+					aliased = true;
+				}
+			}
+			basic_matrix result;
+			basic_matrix scratch;
+			basic_matrix& target = aliased ? result : *this;
+			//Alternate between the two matrices so that
+			//the last partial product lands in the target
+			const basic_matrix* partial = factors[0];
+			for(size_t i = 1; i < count; i++) {
+				basic_matrix& out = ((count - 1 - i) % 2 == 0) ? target : scratch;
+				_multiply_into(*partial, *factors[i], out);
+				partial = &out;
+			}
+			if(aliased) {
+				_swap(result);
+			}
 		}
 
-		void matrix::_invert() {
-			//NOT IMPLEMENTED
+		template<class T>
+		void basic_matrix<T>::_power(int exp) {
+			if(!square()) {
+				throw invalid_argument("Matrix is not square");
+			}
+			//Negate in unsigned arithmetic so the
+			//most negative int does not overflow
+			unsigned int remaining = (exp < 0) ? (0u - static_cast<unsigned int>(exp)) : static_cast<unsigned int>(exp);
+			//Powers of the base by repeated squaring
+			basic_matrix power;
+			if(exp < 0) {
+				basic_lu<T> decomposition(*this);
+				if(!decomposition.invertible()) {
+					throw invalid_argument("Matrix is not invertible");
+				}
+				power = decomposition.inverse();
+			} else {
+				_swap(power);
+			}
+			//Start from the identity and multiply in the
+			//powers for each set bit of the exponent.
+			//Products go into the scratch matrix, which is
+			//then swapped in, so the same three arrays
+			//are reused for every step.
+			basic_matrix scratch(power._rows, power._cols);
+			_allocate(power._rows, power._cols);
+			_make_identity();
+			while(remaining > 0) {
+				if(remaining % 2 == 1) {
+					_multiply_into(*this, power, scratch);
+					_swap(scratch);
+				}
+				remaining /= 2;
+				if(remaining > 0) {
+					_multiply_into(power, power, scratch);
+					power._swap(scratch);
+				}
+			}
+		}
+
+		template<class T>
+		void basic_matrix<T>::_invert() {
+			size_t n = _rows;
+			switch(_structure) {
+			case structure_identity:
+				//The identity is its own inverse
+				return;
+			case structure_diagonal:
+				for(size_t i = 0; i < n; i++) {
+					if(_entries[i * n + i] == 0) {
+						throw logic_error("Matrix is not invertible");
+					}
+				}
+				_unshare();
+				for(size_t i = 0; i < n; i++) {
+					_entries[i * n + i] = 1 / _entries[i * n + i];
+				}
+				return;
+			case structure_similarity:
+			case structure_rigid:
+				{
+					//For sRx + t, the inverse is R^T x / s - R^T t / s,
+					//where the linear part of the matrix is sR
+					//and (sR)^T = s^2 R^-1
+					size_t m = n - 1;
+					T scale = 0;
+					for(size_t k = 0; k < m; k++) {
+						scale += _entries[k * n] * _entries[k * n];
+					}
+					basic_matrix temp(n);
+					for(size_t i = 0; i < m; i++) {
+						T translation = 0;
+						for(size_t j = 0; j < m; j++) {
+							T entry = _entries[j * n + i] / scale;
+							temp._entries[i * n + j] = entry;
+							translation -= entry * _entries[j * n + m];
+						}
+						temp._entries[i * n + m] = translation;
+					}
+					temp._structure = _structure;
+					_swap(temp);
+				}
+				return;
+			case structure_affine:
+				{
+					structure_type s = _structure;
+					*this = basic_lu<T>(*this).inverse();
+					//The inverse is affine too, so remove
+					//rounding error from the last row
+					for(size_t j = 0; j + 1 < n; j++) {
+						_entries[(n - 1) * n + j] = 0;
+					}
+					_entries[(n - 1) * n + n - 1] = 1;
+					_structure = s;
+				}
+				return;
+			default:
+				//The decomposition checks that this matrix is square
+				*this = basic_lu<T>(*this).inverse();
+			}
 		}
+
+		template class basic_matrix<float>;
+		template class basic_matrix<double>;
 	}
 }
\ No newline at end of file
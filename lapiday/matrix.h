@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <stdexcept>
 #include <iostream>
+#include <cassert>
 
 using std::size_t;
 using std::logic_error;
@@ -53,14 +54,77 @@ namespace lapiday {
 		};
 
 		/**
-		* Matrix, useful in linear algebra
+		* Known structure of a matrix, used to choose
+		* faster kernels. Each structure (other than
+		* general) is a guarantee about the entries.
 		*/
-		class matrix {
+		enum structure_type {
+			/**
+			* Nothing is known
+			*/
+			structure_general,
+
+			/**
+			* Square, with a last row of (0, ..., 0, 1)
+			* (an affine transformation in homogeneous
+			* coordinates)
+			*/
+			structure_affine,
+
+			/**
+			* Affine, and the rest of the matrix apart from
+			* the last column is a scaled orthogonal matrix
+			* (rotation, reflection and uniform scaling)
+			*/
+			structure_similarity,
+
+			/**
+			* Similarity with a scale of 1 (rotation and
+			* reflection only)
+			*/
+			structure_rigid,
+
+			/**
+			* Square, with all entries off the diagonal zero
+			*/
+			structure_diagonal,
+
+			/**
+			* Identity matrix
+			*/
+			structure_identity
+		};
+
+		template<class L, class R> class product;
+		template<class T> class basic_lu;
+		template<class T> class basic_const_matrix_view;
+		template<class T> class basic_matrix_view;
+
+		/**
+		* Matrix, useful in linear algebra, with entries
+		* of type T. Only float and double are supported;
+		* matrix is the double version.
+		*/
+		template<class T>
+		class basic_matrix {
 		public:
+			/**
+			* Type of the entries
+			*/
+			typedef T scalar_type;
+
+			/**@{*/
+			/**
+			* Iterator over the entries of one row
+			*/
+			typedef T* row_iterator;
+			typedef const T* const_row_iterator;
+			/**@}*/
+
 			/**
 			* Create a new zero-by-zero matrix
 			*/
-			matrix();
+			basic_matrix();
 
 			/**
 			* Create a new zero matrix with the given number
@@ -68,14 +132,14 @@ namespace lapiday {
 			* @param rows Number of rows
 			* @param cols Number of columns
 			*/
-			matrix(size_t rows, size_t cols);
+			basic_matrix(size_t rows, size_t cols);
 
 			/**
 			* Create a new identity matrix with the given size
 			* (rows and columns).
 			* @param size Number of rows and columns
 			*/
-			matrix(size_t size);
+			basic_matrix(size_t size);
 
 			/**
 			* Create a new elementary matrix of the given size
@@ -86,19 +150,42 @@ namespace lapiday {
 			* cannot be applied to the identity matrix of
 			* the given size
 			*/
-			matrix(size_t size, rowop op);
+			basic_matrix(size_t size, rowop op);
 
 			/**
 			* Create a new matrix equal to the given matrix.
 			* @param m Original matrix
 			*/
-			matrix(const matrix& m);
+			basic_matrix(const basic_matrix& m);
+
+			/**
+			* Create a new matrix by taking over the entries
+			* of the given matrix, which is left empty
+			* (zero-by-zero).
+			* @param m Original matrix
+			*/
+			basic_matrix(basic_matrix&& m);
+
+			/**
+			* Create a new matrix equal to the given product,
+			* evaluating it without intermediate matrices.
+			* @param p Product to evaluate
+			*/
+			template<class L, class R>
+			basic_matrix(const product<L, R>& p);
+
+			/**
+			* Create a new matrix with the entries of
+			* the given view.
+			* @param v View to copy
+			*/
+			explicit basic_matrix(const basic_const_matrix_view<T>& v);
 
 			/**
 			* Deallocate all dynamic memory associated
 			* with this object.
 			*/
-			~matrix();
+			~basic_matrix();
 
 			/**
 			* Get the number of rows this matrix has.
@@ -119,11 +206,59 @@ namespace lapiday {
 			*/
 			bool square() const;
 
+			/**
+			* Get the known structure of this matrix.
+			* Writing to an entry through the non-const
+			* operator() makes the structure general.
+			* @return Structure
+			*/
+			structure_type structure() const;
+
+			/**
+			* Set the structure of this matrix to the most
+			* specific of identity, diagonal, affine and
+			* general that its entries satisfy exactly.
+			* Similarity and rigid structure can only be
+			* set with assume_structure().
+			*/
+			void detect_structure();
+
+			/**
+			* Set the structure of this matrix, after
+			* checking it. Similarity and rigid structure
+			* are checked up to rounding error.
+			* @param s Structure
+			* @throw invalid_argument If the entries do not
+			* have the given structure
+			*/
+			void assume_structure(structure_type s);
+
+			/**
+			* Check if copies of this matrix share its entries.
+			* @return true if copy-on-write is enabled,
+			* false otherwise
+			*/
+			bool copy_on_write() const;
+
+			/**
+			* Enable or disable copy-on-write. When enabled,
+			* copying this matrix only shares its entries
+			* (if they are on the heap), and the entries are
+			* copied when either matrix is first changed.
+			* Copies made this way have copy-on-write enabled
+			* too. Matrices that share entries can be used
+			* from different threads. Assigning to a matrix
+			* does not change its own setting.
+			* @param enabled Whether or not to share entries
+			* with copies
+			*/
+			void set_copy_on_write(bool enabled);
+
 			/**
 			* Get the transpose of this matrix.
 			* @return Transpose
 			*/
-			matrix transpose() const;
+			basic_matrix transpose() const;
 
 			/**
 			* Check if this matrix is symmetric.
@@ -140,7 +275,7 @@ namespace lapiday {
 			* the given matrix have the same
 			* size, false otherwise
 			*/
-			bool same_size(const matrix& m) const;
+			bool same_size(const basic_matrix& m) const;
 
 			/**
 			* Perform a row operation on this matrix.
@@ -155,19 +290,26 @@ namespace lapiday {
 			/**
 			* Reduce this matrix to reduced row-echelon
 			* form with Gauss-Jordan elimination.
+			* The largest available entry in each column
+			* is used as the pivot. Entries that are zero
+			* up to rounding error (relative to the largest
+			* entry in their column) are treated as zero.
 			*/
 			void gauss_jordan();
 
 			/**
-			* Get the determinant of this matrix.
+			* Get the determinant of this matrix,
+			* using an LU decomposition.
 			* @return Determinant
 			* @throw logic_error If this matrix is not square
 			*/
-			double determinant() const;
+			T determinant() const;
 
 			/**
 			* Check if this matrix is invertible
-			* (determinant is not 0).
+			* (determinant is not 0). This is checked
+			* with an LU decomposition, so it is not
+			* affected by the determinant underflowing.
 			* @return true if this matrix is invertible,
 			* false otherwise
 			*/
@@ -180,14 +322,14 @@ namespace lapiday {
 			* square, or if this matrix is square but
 			* not invertible
 			*/
-			matrix inverse() const;
+			basic_matrix inverse() const;
 
 			/**
 			* Get the adjoint (adjugate) matrix of this matrix.
 			* @return Adjoint (adjugate) matrix
 			* @throw logic_error If this matrix is not square
 			*/
-			matrix adjoint() const;
+			basic_matrix adjoint() const;
 
 			/**
 			* Get the submatrix obtained by deleting the given
@@ -199,7 +341,20 @@ namespace lapiday {
 			* @throw invalid_argument If the row or column
 			* is not in the range of this matrix
 			*/
-			matrix submatrix(size_t i, size_t j) const;
+			basic_matrix submatrix(size_t i, size_t j) const;
+
+			/**@{*/
+			/**
+			* Get a view of all entries of this matrix,
+			* which can be narrowed down to blocks, rows,
+			* columns and transposes without copying.
+			* Getting a writable view makes the structure
+			* general.
+			* @return View
+			*/
+			basic_const_matrix_view<T> view() const;
+			basic_matrix_view<T> view();
+			/**@}*/
 
 			/**@{*/
 			/**
@@ -210,8 +365,60 @@ namespace lapiday {
 			* @throw out_of_range If the row or column
 			* is not in the range of this matrix
 			*/
-			double& operator()(size_t i, size_t j);
-			double operator()(size_t i, size_t j) const;
+			T& operator()(size_t i, size_t j);
+			T operator()(size_t i, size_t j) const;
+			/**@}*/
+
+			/**@{*/
+			/**
+			* Get the entry at the given position without
+			* checking the row and column, except by an
+			* assertion in debug builds. Getting a writable
+			* entry makes the structure general.
+			* @param i Row (zero-based)
+			* @param j Column (zero-based)
+			* @return Entry
+			*/
+			T& unchecked(size_t i, size_t j);
+			T unchecked(size_t i, size_t j) const;
+			/**@}*/
+
+			/**@{*/
+			/**
+			* Get the entries as one array in row-major order,
+			* so entry (i, j) is at i * cols() + j. Getting a
+			* writable array makes the structure general. The
+			* pointer is invalidated when the matrix changes
+			* size, is assigned to or moved from, or (with
+			* copy-on-write) is first changed after being copied.
+			* @return First entry, or NULL if there are none
+			*/
+			const T* data() const;
+			T* data();
+			/**@}*/
+
+			/**@{*/
+			/**
+			* Get an iterator to the first entry of a row.
+			* The row is only checked by an assertion in
+			* debug builds.
+			* @param i Row (zero-based)
+			* @return Iterator
+			*/
+			row_iterator row_begin(size_t i);
+			const_row_iterator row_begin(size_t i) const;
+			/**@}*/
+
+			/**@{*/
+			/**
+			* Get an iterator past the last entry of a row.
+			* The row is only checked by an assertion in
+			* debug builds.
+			* @param i Row (zero-based)
+			* @return Iterator
+			*/
+			row_iterator row_end(size_t i);
+			const_row_iterator row_end(size_t i) const;
 			/**@}*/
 
 			/**
@@ -221,7 +428,9 @@ namespace lapiday {
 			* @return true if the matrices are equal,
 			* false otherwise
 			*/
-			friend bool operator ==(const matrix& first, const matrix& second);
+			friend bool operator ==(const basic_matrix& first, const basic_matrix& second) {
+				return first._equals(second);
+			}
 
 			/**
 			* Check if the two matrices are not equal.
@@ -230,7 +439,9 @@ namespace lapiday {
 			* @return true if the matrices are not equal,
 			* false otherwise
 			*/
-			friend bool operator !=(const matrix& first, const matrix& second);
+			friend bool operator !=(const basic_matrix& first, const basic_matrix& second) {
+				return !first._equals(second);
+			}
 
 			/**
 			* Add two matrices.
@@ -240,7 +451,11 @@ namespace lapiday {
 			* @throw invalid_argument If the matrices do not
 			* have the same size
 			*/
-			friend matrix operator +(const matrix& first, const matrix& second);
+			friend basic_matrix operator +(const basic_matrix& first, const basic_matrix& second) {
+				basic_matrix temp = first;
+				temp._add(second);
+				return temp;
+			}
 
 			/**
 			* Add a matrix to this matrix.
@@ -249,7 +464,7 @@ namespace lapiday {
 			* @throw invalid_argument If the given matrix
 			* is not the same size as this matrix
 			*/
-			matrix& operator +=(const matrix& m);
+			basic_matrix& operator +=(const basic_matrix& m);
 
 			/**
 			* Subtract one matrix from the other
@@ -259,7 +474,9 @@ namespace lapiday {
 			* @throw invalid_argument If the matrices do not
 			* have the same size
 			*/
-			friend matrix operator -(const matrix& min, const matrix& sub);
+			friend basic_matrix operator -(const basic_matrix& min, const basic_matrix& sub) {
+				return (min + (-sub));
+			}
 
 			/**
 			* Subtract a matrix from this matrix.
@@ -268,7 +485,7 @@ namespace lapiday {
 			* @throw invalid_argument If the given matrix
 			* is not the same size as this matrix
 			*/
-			matrix& operator -=(const matrix& m);
+			basic_matrix& operator -=(const basic_matrix& m);
 
 			/**@{*/
 			/**
@@ -277,8 +494,17 @@ namespace lapiday {
 			* @param m Matrix
 			* @return Scalar multiple
 			*/
-			friend matrix operator *(double scalar, const matrix& m);
-			friend matrix operator *(const matrix& m, double scalar);
+			friend basic_matrix operator *(T scalar, const basic_matrix& m) {
+				basic_matrix temp = m;
+				temp._multiply(scalar);
+				return temp;
+			}
+
+			friend basic_matrix operator *(const basic_matrix& m, T scalar) {
+				basic_matrix temp = m;
+				temp._multiply(scalar);
+				return temp;
+			}
 			/**@}*/
 
 			/**
@@ -286,7 +512,7 @@ namespace lapiday {
 			* @param scalar Scalar
 			* @return This matrix
 			*/
-			matrix& operator *=(double scalar);
+			basic_matrix& operator *=(T scalar);
 
 			/**
 			* Divide a matrix by a scalar (multiply the matrix
@@ -296,7 +522,11 @@ namespace lapiday {
 			* @return Scalar multiple
 			* @throw invalid_argument If the scalar is zero
 			*/
-			friend matrix operator /(const matrix& m, double scalar);
+			friend basic_matrix operator /(const basic_matrix& m, T scalar) {
+				basic_matrix temp = m;
+				temp /= scalar;
+				return temp;
+			}
 
 			/**
 			* Divide this matrix by a scalar (multiply it
@@ -305,24 +535,28 @@ namespace lapiday {
 			* @return This matrix
 			* @throw invalid_argument If the scalar is zero
 			*/
-			matrix& operator /=(double scalar);
+			basic_matrix& operator /=(T scalar);
 
 			/**
 			* Negate a matrix (multiply it by
 			* the scalar -1).
 			* @return Negative
 			*/
-			matrix operator -() const;
+			basic_matrix operator -() const;
 
 			/**
-			* Multiply two matrices.
+			* Multiply two matrices. The product is evaluated
+			* when it is assigned to a matrix, so chains of
+			* products are computed without temporary matrices.
 			* @param first First factor
 			* @param second Second factor
 			* @return Product
 			* @throw invalid_argument If the matrices cannot
 			* be multiplied in this order
 			*/
-			friend matrix operator *(const matrix& first, const matrix& second);
+			friend product<basic_matrix, basic_matrix> operator *(const basic_matrix& first, const basic_matrix& second) {
+				return product<basic_matrix, basic_matrix>(first, second);
+			}
 
 			/**
 			* Multiply this matrix by another matrix.
@@ -331,7 +565,7 @@ namespace lapiday {
 			* be multiplied with this matrix on the left
 			* @return This matrix
 			*/
-			matrix& operator *=(const matrix& m);
+			basic_matrix& operator *=(const basic_matrix& m);
 
 			/**
 			* Exponentiate the matrix (multiply it by itself).
@@ -345,7 +579,11 @@ namespace lapiday {
 			* or if the exponent is negative and the matrix is
 			* not invertible
 			*/
-			friend matrix operator ^(const matrix& m, int exp);
+			friend basic_matrix operator ^(const basic_matrix& m, int exp) {
+				basic_matrix temp = m;
+				temp._power(exp);
+				return temp;
+			}
 
 			/**
 			* Exponentiate this matrix (multiply it by itself).
@@ -358,14 +596,33 @@ namespace lapiday {
 			* or if the exponent is negative and the matrix is
 			* not invertible
 			*/
-			matrix& operator ^=(int exp);
+			basic_matrix& operator ^=(int exp);
 
 			/**
 			* Assign another matrix to this matrix.
 			* @param m Matrix to assign
 			* @return A reference to this matrix
 			*/
-			matrix& operator =(const matrix& m);
+			basic_matrix& operator =(const basic_matrix& m);
+
+			/**
+			* Assign another matrix to this matrix by taking
+			* over its entries. The other matrix receives
+			* the old entries of this matrix.
+			* @param m Matrix to assign
+			* @return A reference to this matrix
+			*/
+			basic_matrix& operator =(basic_matrix&& m);
+
+			/**
+			* Assign a product to this matrix, evaluating it
+			* without intermediate matrices. This matrix may
+			* be one of the factors.
+			* @param p Product to assign
+			* @return A reference to this matrix
+			*/
+			template<class L, class R>
+			basic_matrix& operator =(const product<L, R>& p);
 
 			/**
 			* Output this matrix to the stream.
@@ -373,12 +630,57 @@ namespace lapiday {
 			* @param m Matrix to output
 			* @return The stream
 			*/
-			friend ostream& operator <<(ostream& out, const matrix& m);
+			friend ostream& operator <<(ostream& out, const basic_matrix& m) {
+				m._write(out);
+				return out;
+			}
+
+			/**
+			* Set this matrix to the entries of the given
+			* view, reusing the array if the number of
+			* entries is the same. The view may be of
+			* this matrix.
+			* @param v View to copy
+			* @return This matrix
+			*/
+			basic_matrix& operator =(const basic_const_matrix_view<T>& v);
+
+			/**
+			* Multiply the matrices of two views, storing
+			* the product in a matrix, whose array is reused
+			* if it has the right number of entries.
+			* @param first First factor
+			* @param second Second factor
+			* @param out Matrix to store the product in
+			* (which may be viewed by the factors)
+			* @throw invalid_argument If the matrices
+			* cannot be multiplied in the given order
+			*/
+			friend void multiply(const basic_const_matrix_view<T>& first, const basic_const_matrix_view<T>& second, basic_matrix& out) {
+				_multiply_views(first, second, out);
+			}
+
+			friend class basic_lu<T>;
+			template<class U>
+			friend void read_binary(std::istream& in, basic_matrix<U>& m);
 		private:
 			/**
-			* Entries, as an array of pointers to rows
+			* Largest number of entries stored inside the
+			* object instead of on the heap (enough for 4-by-4)
+			*/
+			static const size_t INLINE_CAPACITY = 16;
+
+			/**
+			* Entries, as a single array in row-major order
+			* (NULL if the matrix has no entries). This points
+			* to _inline if there are few enough entries.
 			*/
-			double** _entries;
+			T* _entries;
+
+			/**
+			* Storage for the entries of small matrices
+			*/
+			T _inline[INLINE_CAPACITY];
 
 			/**
 			* Number of rows
@@ -390,34 +692,108 @@ namespace lapiday {
 			*/
 			size_t _cols;
 
+			/**
+			* Known structure of the entries
+			*/
+			structure_type _structure;
+
+			/**
+			* Whether or not copies share the entries
+			*/
+			bool _copy_on_write;
+
+			/**
+			* Check if the entries have the given structure.
+			* @param s Structure
+			* @return true if the entries have the structure,
+			* false otherwise
+			*/
+			bool _has_structure(structure_type s) const;
+
+			/**
+			* Check if this matrix is equal to another matrix.
+			* @param m Matrix to compare with
+			* @return true if the matrices are equal,
+			* false otherwise
+			*/
+			bool _equals(const basic_matrix& m) const;
+
+			/**
+			* Output the entries of this matrix to the stream,
+			* one row per line.
+			* @param out Stream to output to
+			*/
+			void _write(ostream& out) const;
+
+			/**
+			* Copy the submatrix obtained by deleting the
+			* given row and column into the given matrix,
+			* which must already be the right size.
+			* @param i Row to delete (zero-based)
+			* @param j Column to delete (zero-based)
+			* @param out Matrix to copy into
+			*/
+			void _copy_submatrix(size_t i, size_t j, basic_matrix& out) const;
+
 			/**
 			* Allocate memory for the given number of rows
-			* and columns. The members _rows and _cols are
-			* set appropriately. If _entries is not NULL,
-			* old data is deleted.
+			* and columns, using the inline storage if there
+			* are few enough entries. The members _rows and
+			* _cols are set appropriately. If _entries is not
+			* NULL, old data is deleted, unless the old array
+			* already has exactly the right number of entries,
+			* in which case it is kept (with unspecified values).
 			* @param rows Number of rows to allocate
 			* @param cols Number of columns to allocate
 			*/
 			void _allocate(size_t rows, size_t cols);
 
+			/**
+			* Check if the entries are shared with
+			* another matrix.
+			* @return true if the entries are shared,
+			* false otherwise
+			*/
+			bool _shared() const;
+
+			/**
+			* Copy the entries into a new array if they are
+			* shared with another matrix, so that they can
+			* be changed. This must be called before changing
+			* entries that were not just allocated.
+			*/
+			void _unshare();
+
 			/**
 			* Deallocate all memory for the entries
-			* and set _entries to NULL, if _entries
-			* is not already NULL. The members
-			* _rows and _cols are not affected.
+			* (unless they are inline) and set _entries
+			* to NULL, if _entries is not already NULL.
+			* The members _rows and _cols are not affected.
 			*/
 			void _deallocate_entries();
 
 			/**
 			* Copy the data from another matrix,
 			* allocating and deallocating as necessary.
+			* If the other matrix has copy-on-write enabled,
+			* its heap array is shared instead.
 			* @param m Matrix to copy from
 			*/
-			void _copy_data(const matrix& m);
+			void _copy_data(const basic_matrix& m);
+
+			/**
+			* Exchange the entries and dimensions of this
+			* matrix with those of another matrix. Only
+			* inline entries are copied; heap arrays
+			* change owner.
+			* @param m Matrix to exchange with
+			*/
+			void _swap(basic_matrix& m);
 
 			/**
 			* Make this matrix an identity matrix,
-			* if the matrix is square (_rows == _cols).
+			* if the matrix is square (_rows == _cols),
+			* and set the structure to identity.
 			*/
 			void _make_identity();
 
@@ -427,13 +803,13 @@ namespace lapiday {
 			* @throw invalid_argument If the matrices do not
 			* have the same size
 			*/
-			void _add(const matrix& m);
+			void _add(const basic_matrix& m);
 
 			/**
 			* Multiply this matrix by a scalar.
 			* @param scalar Scalar
 			*/
-			void _multiply(double scalar);
+			void _multiply(T scalar);
 
 			/**
 			* Multiply this matrix by another matrix.
@@ -441,7 +817,72 @@ namespace lapiday {
 			* @throw invalid_argument If the matrices cannot
 			* be multiplied with this matrix on the left
 			*/
-			void _multiply(const matrix& m);
+			void _multiply(const basic_matrix& m);
+
+			/**
+			* Multiply two matrices, storing the product
+			* in a third matrix (whose entries are reused
+			* if it already has the right number of them).
+			* The output must not be one of the factors.
+			* @param first First factor
+			* @param second Second factor
+			* @param out Matrix to store the product in
+			* @throw invalid_argument If the matrices cannot
+			* be multiplied in the given order
+			*/
+			static void _multiply_into(const basic_matrix& first, const basic_matrix& second, basic_matrix& out);
+
+			/**
+			* Multiply two matrices whose structures allow
+			* skipping work, storing the product in a third
+			* matrix. The structure of the product is set.
+			* @param first First factor
+			* @param second Second factor
+			* @param out Matrix to store the product in
+			* (not one of the factors)
+			* @return true if a structured kernel was used,
+			* false if neither factor has a useful structure
+			* (out is then unchanged)
+			*/
+			static bool _multiply_structured(const basic_matrix& first, const basic_matrix& second, basic_matrix& out);
+
+			/**
+			* Multiply the matrices of two views, storing
+			* the product in a matrix.
+			* @param first First factor
+			* @param second Second factor
+			* @param out Matrix to store the product in
+			* (which may be viewed by the factors)
+			* @throw invalid_argument If the matrices
+			* cannot be multiplied in the given order
+			*/
+			static void _multiply_views(const basic_const_matrix_view<T>& first, const basic_const_matrix_view<T>& second, basic_matrix& out);
+
+			/**
+			* Set this matrix to the product of the given
+			* factors, in order. At most one matrix other
+			* than this one is allocated, regardless of the
+			* number of factors.
+			* @param factors Factors of the product
+			* @param count Number of factors (at least 2)
+			* @throw invalid_argument If the matrices cannot
+			* be multiplied in the given order
+			*/
+			void _assign_product(const basic_matrix* const* factors, size_t count);
+
+			/**
+			* Exponentiate this matrix by repeated squaring,
+			* using O(log |exp|) multiplications and no
+			* allocations beyond three matrices.
+			* If the exponent is negative, the matrix is
+			* inverted first. If the exponent is zero,
+			* this matrix becomes the identity matrix.
+			* @param exp Exponent
+			* @throw invalid_argument If this matrix is not square,
+			* or if the exponent is negative and the matrix is
+			* not invertible
+			*/
+			void _power(int exp);
 
 			/**
 			* Invert this matrix (set this matrix to its
@@ -452,6 +893,328 @@ namespace lapiday {
 			*/
 			void _invert();
 		};
+
+		/**
+		* Matrix of doubles
+		*/
+		typedef basic_matrix<double> matrix;
+
+		//Element access is defined inline so that loops
+		//outside the class do not call a function per entry
+
+		template<class T>
+		inline T& basic_matrix<T>::unchecked(size_t i, size_t j) {
+			assert((i < _rows) && (j < _cols));
+			return data()[i * _cols + j];
+		}
+
+		template<class T>
+		inline T basic_matrix<T>::unchecked(size_t i, size_t j) const {
+			assert((i < _rows) && (j < _cols));
+			return _entries[i * _cols + j];
+		}
+
+		template<class T>
+		inline const T* basic_matrix<T>::data() const {
+			return _entries;
+		}
+
+		template<class T>
+		inline T* basic_matrix<T>::data() {
+			//The entries may be changed through the pointer
+			_unshare();
+			_structure = structure_general;
+			return _entries;
+		}
+
+		template<class T>
+		inline typename basic_matrix<T>::row_iterator basic_matrix<T>::row_begin(size_t i) {
+			assert(i < _rows);
+			return data() + i * _cols;
+		}
+
+		template<class T>
+		inline typename basic_matrix<T>::const_row_iterator basic_matrix<T>::row_begin(size_t i) const {
+			assert(i < _rows);
+			return _entries + i * _cols;
+		}
+
+		template<class T>
+		inline typename basic_matrix<T>::row_iterator basic_matrix<T>::row_end(size_t i) {
+			assert(i < _rows);
+			return data() + (i + 1) * _cols;
+		}
+
+		template<class T>
+		inline typename basic_matrix<T>::const_row_iterator basic_matrix<T>::row_end(size_t i) const {
+			assert(i < _rows);
+			return _entries + (i + 1) * _cols;
+		}
+
+		/**
+		* Number of matrices multiplied together
+		* in an expression
+		*/
+		template<class E>
+		struct factor_count {
+			static const size_t value = 1;
+		};
+
+		template<class L, class R>
+		struct factor_count<product<L, R> > {
+			static const size_t value = factor_count<L>::value + factor_count<R>::value;
+		};
+
+		/**
+		* Product of matrices (or of other products) that
+		* has not been evaluated yet. Assigning it to a
+		* matrix evaluates the whole chain at once. It can
+		* also be used like a const matrix (element access,
+		* transpose(), determinant() and so on), which
+		* evaluates it once and keeps the result.
+		* A product only refers to its factors, so it must
+		* be used before the factors are destroyed (usually
+		* in the same statement). In particular,
+		* auto p = a * b * c; keeps a reference to the
+		* temporary a * b, which is destroyed at the end of
+		* the statement, so store products in a matrix
+		* instead of with auto.
+		*/
+		template<class L, class R>
+		class product {
+		public:
+			/**
+			* Type of the entries
+			*/
+			typedef typename L::scalar_type scalar_type;
+
+			/**
+			* Create a new product of the given factors.
+			* @param left First factor
+			* @param right Second factor
+			* @throw invalid_argument If the factors cannot
+			* be multiplied in this order
+			*/
+			product(const L& left, const R& right) : _left(left), _right(right), _evaluated(false) {
+				if(left.cols() != right.rows()) {
+					throw invalid_argument("Matrices cannot be multiplied in the given order");
+				}
+			}
+
+			/**
+			* Get the number of rows the product has.
+			* @return Number of rows
+			*/
+			size_t rows() const {
+				return _left.rows();
+			}
+
+			/**
+			* Get the number of columns the product has.
+			* @return Number of columns
+			*/
+			size_t cols() const {
+				return _right.cols();
+			}
+
+			/**
+			* Get the first factor.
+			* @return First factor
+			*/
+			const L& left() const {
+				return _left;
+			}
+
+			/**
+			* Get the second factor.
+			* @return Second factor
+			*/
+			const R& right() const {
+				return _right;
+			}
+
+			/**
+			* Evaluate the product, the first time
+			* this is called.
+			* @return Value of the product
+			*/
+			const basic_matrix<scalar_type>& evaluate() const {
+				if(!_evaluated) {
+					_value = *this;
+					_evaluated = true;
+				}
+				return _value;
+			}
+
+			/**@{*/
+			/**
+			* Same as for a const matrix, on the
+			* value of the product (see evaluate()).
+			*/
+			bool square() const {
+				return rows() == cols();
+			}
+
+			structure_type structure() const {
+				return evaluate().structure();
+			}
+
+			basic_matrix<scalar_type> transpose() const {
+				return evaluate().transpose();
+			}
+
+			bool symmetric() const {
+				return evaluate().symmetric();
+			}
+
+			bool same_size(const basic_matrix<scalar_type>& m) const {
+				return (rows() == m.rows()) && (cols() == m.cols());
+			}
+
+			scalar_type determinant() const {
+				return evaluate().determinant();
+			}
+
+			bool invertible() const {
+				return evaluate().invertible();
+			}
+
+			basic_matrix<scalar_type> inverse() const {
+				return evaluate().inverse();
+			}
+
+			basic_matrix<scalar_type> adjoint() const {
+				return evaluate().adjoint();
+			}
+
+			basic_matrix<scalar_type> submatrix(size_t i, size_t j) const {
+				return evaluate().submatrix(i, j);
+			}
+
+			basic_const_matrix_view<scalar_type> view() const {
+				return evaluate().view();
+			}
+
+			scalar_type operator()(size_t i, size_t j) const {
+				return evaluate()(i, j);
+			}
+
+			scalar_type unchecked(size_t i, size_t j) const {
+				return evaluate().unchecked(i, j);
+			}
+
+			const scalar_type* data() const {
+				return evaluate().data();
+			}
+
+			typename basic_matrix<scalar_type>::const_row_iterator row_begin(size_t i) const {
+				return evaluate().row_begin(i);
+			}
+
+			typename basic_matrix<scalar_type>::const_row_iterator row_end(size_t i) const {
+				return evaluate().row_end(i);
+			}
+			/**@}*/
+		private:
+			/**
+			* First factor
+			*/
+			const L& _left;
+
+			/**
+			* Second factor
+			*/
+			const R& _right;
+
+			/**
+			* Value of the product, once evaluated
+			*/
+			mutable basic_matrix<scalar_type> _value;
+
+			/**
+			* Whether or not the product has been evaluated
+			*/
+			mutable bool _evaluated;
+		};
+
+		/**@{*/
+		/**
+		* Store pointers to the matrices multiplied together
+		* in an expression, from left to right.
+		* @param e Expression
+		* @param out Array to store the pointers in
+		* @return Position in the array after the last pointer
+		*/
+		template<class T>
+		const basic_matrix<T>** collect_factors(const basic_matrix<T>& e, const basic_matrix<T>** out) {
+			*out = &e;
+			return out + 1;
+		}
+
+		template<class L, class R>
+		const basic_matrix<typename product<L, R>::scalar_type>** collect_factors(const product<L, R>& e, const basic_matrix<typename product<L, R>::scalar_type>** out) {
+			return collect_factors(e.right(), collect_factors(e.left(), out));
+		}
+		/**@}*/
+
+		/**@{*/
+		/**
+		* Multiply a product by a matrix or another product,
+		* without evaluating either of them.
+		* @param first First factor
+		* @param second Second factor
+		* @return Product
+		* @throw invalid_argument If the factors cannot
+		* be multiplied in this order
+		*/
+		template<class L, class R, class T>
+		product<product<L, R>, basic_matrix<T> > operator *(const product<L, R>& first, const basic_matrix<T>& second) {
+			return product<product<L, R>, basic_matrix<T> >(first, second);
+		}
+
+		template<class T, class L, class R>
+		product<basic_matrix<T>, product<L, R> > operator *(const basic_matrix<T>& first, const product<L, R>& second) {
+			return product<basic_matrix<T>, product<L, R> >(first, second);
+		}
+
+		template<class L1, class R1, class L2, class R2>
+		product<product<L1, R1>, product<L2, R2> > operator *(const product<L1, R1>& first, const product<L2, R2>& second) {
+			return product<product<L1, R1>, product<L2, R2> >(first, second);
+		}
+		/**@}*/
+
+		/**
+		* Output a product to the stream, evaluating it first.
+		* @param out Stream to output to
+		* @param p Product to output
+		* @return The stream
+		*/
+		template<class L, class R>
+		ostream& operator <<(ostream& out, const product<L, R>& p) {
+			return out << basic_matrix<typename product<L, R>::scalar_type>(p);
+		}
+
+		template<class T>
+		template<class L, class R>
+		basic_matrix<T>::basic_matrix(const product<L, R>& p) {
+			_entries = NULL;
+			_rows = 0;
+			_cols = 0;
+			_structure = structure_general;
+			_copy_on_write = false;
+			const basic_matrix* factors[factor_count<product<L, R> >::value];
+			collect_factors(p, factors);
+			_assign_product(factors, factor_count<product<L, R> >::value);
+		}
+
+		template<class T>
+		template<class L, class R>
+		basic_matrix<T>& basic_matrix<T>::operator =(const product<L, R>& p) {
+			const basic_matrix* factors[factor_count<product<L, R> >::value];
+			collect_factors(p, factors);
+			_assign_product(factors, factor_count<product<L, R> >::value);
+			return *this;
+		}
 	}
 }
 
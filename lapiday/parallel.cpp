@@ -0,0 +1,324 @@
+#include "parallel.h"
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+using std::size_t;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::try_to_lock;
+using std::condition_variable;
+using std::atomic;
+using std::exception_ptr;
+using std::current_exception;
+using std::rethrow_exception;
+using std::min;
+
+namespace lapiday {
+	namespace parallel {
+		namespace {
+			/**
+			 * Ranges of items being run by the pool
+			 */
+			struct job {
+				/**
+				 * Task to run on each range
+				 */
+				const range_task* task;
+
+				/**
+				 * Number of items
+				 */
+				size_t count;
+
+				/**
+				 * Number of items per range
+				 */
+				size_t range_size;
+
+				/**
+				 * Number of ranges
+				 */
+				size_t ranges;
+
+				/**
+				 * Next range to be claimed by a thread
+				 */
+				atomic<size_t> next;
+
+				/**
+				 * First exception thrown by the task
+				 */
+				exception_ptr error;
+
+				/**
+				 * Protects error
+				 */
+				mutex error_mutex;
+			};
+
+			/**
+			 * Claim and run ranges of a job until none are left.
+			 * @param j Job
+			 */
+			void run_ranges(job& j) {
+				size_t range;
+				while((range = j.next.fetch_add(1)) < j.ranges) {
+					size_t begin = range * j.range_size;
+					size_t end = min(begin + j.range_size, j.count);
+					try {
+						(*j.task)(begin, end);
+					} catch(...) {
+						lock_guard<mutex> lock(j.error_mutex);
+						if(!j.error) {
+							j.error = current_exception();
+						}
+					}
+				}
+			}
+
+			/**
+			 * Worker threads that wait for jobs
+			 */
+			class pool {
+			public:
+				/**
+				 * Create a pool with no workers.
+				 */
+				pool() {
+					_job = NULL;
+					_generation = 0;
+					_active = 0;
+					_stopping = false;
+				}
+
+				/**
+				 * Stop and join the workers.
+				 */
+				~pool() {
+					resize(0);
+				}
+
+				/**
+				 * Get the number of workers.
+				 * @return Number of workers
+				 */
+				size_t size() const {
+					return _workers.size();
+				}
+
+				/**
+				 * Replace the workers with the given number
+				 * of new workers. No job may be running.
+				 * @param workers Number of workers
+				 */
+				void resize(size_t workers) {
+					{
+						lock_guard<mutex> lock(_mutex);
+						_stopping = true;
+					}
+					_wake.notify_all();
+					for(size_t i = 0; i < _workers.size(); i++) {
+						_workers[i].join();
+					}
+					_workers.clear();
+					_stopping = false;
+					for(size_t i = 0; i < workers; i++) {
+						_workers.push_back(thread(&pool::_work, this));
+					}
+				}
+
+				/**
+				 * Run a job on the workers and the calling
+				 * thread, and wait for it to finish.
+				 * @param j Job
+				 */
+				void run(job& j) {
+					{
+						lock_guard<mutex> lock(_mutex);
+						_job = &j;
+						_generation++;
+					}
+					_wake.notify_all();
+					run_ranges(j);
+					//Every range has been claimed, so wait for
+					//the workers still running one
+					unique_lock<mutex> lock(_mutex);
+					while(_active > 0) {
+						_finished.wait(lock);
+					}
+					//Workers that wake up late must not see the job
+					_job = NULL;
+				}
+			private:
+				/**
+				 * Worker threads
+				 */
+				vector<thread> _workers;
+
+				/**
+				 * Protects the members below
+				 */
+				mutex _mutex;
+
+				/**
+				 * Signalled when there is a new job,
+				 * or the workers should stop
+				 */
+				condition_variable _wake;
+
+				/**
+				 * Signalled when a worker finishes its
+				 * part of a job
+				 */
+				condition_variable _finished;
+
+				/**
+				 * Current job (NULL if there is none)
+				 */
+				job* _job;
+
+				/**
+				 * Number of jobs started so far, so that
+				 * workers run each job at most once
+				 */
+				unsigned long _generation;
+
+				/**
+				 * Number of workers running ranges
+				 */
+				size_t _active;
+
+				/**
+				 * Whether or not the workers should stop
+				 */
+				bool _stopping;
+
+				/**
+				 * Run jobs until told to stop.
+				 */
+				void _work() {
+					unique_lock<mutex> lock(_mutex);
+					unsigned long seen = _generation;
+					while(true) {
+						while(!_stopping && ((_job == NULL) || (_generation == seen))) {
+							_wake.wait(lock);
+						}
+						if(_stopping) {
+							return;
+						}
+						seen = _generation;
+						job* j = _job;
+						_active++;
+						lock.unlock();
+						run_ranges(*j);
+						lock.lock();
+						_active--;
+						if(_active == 0) {
+							_finished.notify_all();
+						}
+					}
+				}
+			};
+
+			/**
+			 * Requested number of threads (0 for one per
+			 * hardware thread)
+			 */
+			atomic<size_t> requested_threads(0);
+
+			/**
+			 * Held while the pool runs a job, so that only
+			 * one caller uses it at a time
+			 */
+			mutex pool_mutex;
+
+			/**
+			 * Whether or not this thread is running a job
+			 * (and so may already hold pool_mutex)
+			 */
+			thread_local bool in_job = false;
+
+			/**
+			 * Get the pool, creating it on the first call.
+			 * @return Pool
+			 */
+			pool& get_pool() {
+				static pool instance;
+				return instance;
+			}
+
+			/**
+			 * Run a task on ranges of the given size, using
+			 * the pool if possible.
+			 * @param count Number of items
+			 * @param range_size Number of items per range
+			 * @param threads Number of threads to use
+			 * @param task Task to run
+			 */
+			void run_job(size_t count, size_t range_size, size_t threads, const range_task& task) {
+				if((threads == 1) || (range_size == 0) || (range_size >= count) || in_job) {
+					task(0, count);
+					return;
+				}
+				unique_lock<mutex> lock(pool_mutex, try_to_lock);
+				if(!lock.owns_lock()) {
+					//Another thread is using the pool
+					task(0, count);
+					return;
+				}
+				pool& p = get_pool();
+				if(p.size() != threads - 1) {
+					p.resize(threads - 1);
+				}
+				job j;
+				j.task = &task;
+				j.count = count;
+				j.range_size = range_size;
+				j.ranges = (count + range_size - 1) / range_size;
+				j.next = 0;
+				in_job = true;
+				p.run(j);
+				in_job = false;
+				if(j.error) {
+					rethrow_exception(j.error);
+				}
+			}
+		}
+
+		void set_thread_count(size_t count) {
+			requested_threads = count;
+		}
+
+		size_t thread_count() {
+			size_t count = requested_threads;
+			if(count == 0) {
+				count = thread::hardware_concurrency();
+			}
+			return (count > 0) ? count : 1;
+		}
+
+		void for_ranges(size_t count, size_t granularity, const range_task& task) {
+			size_t threads = thread_count();
+			if(granularity == 0) {
+				granularity = 1;
+			}
+			//Whole multiples of the granularity, about one
+			//range per thread
+			size_t units = (count + granularity - 1) / granularity;
+			run_job(count, ((units + threads - 1) / threads) * granularity, threads, task);
+		}
+
+		void for_chunks(size_t count, size_t chunk_size, const range_task& task) {
+			run_job(count, (chunk_size > 0) ? chunk_size : 1, thread_count(), task);
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef LAPIDAY_PARALLEL_H
+#define LAPIDAY_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+using std::size_t;
+
+/**
+ * Thread pool shared by the whole library, used to
+ * split large operations into ranges of rows.
+ * Each range is computed exactly as it would be
+ * without threads, so results do not depend on
+ * the number of threads.
+ */
+namespace lapiday {
+	namespace parallel {
+		/**
+		 * Smallest number of entries for which
+		 * element-wise operations are split
+		 * between threads
+		 */
+		const size_t PARALLEL_MIN_ENTRIES = 1 << 16;
+
+		/**
+		 * Smallest amount of work (rows times inner
+		 * dimension times columns) for which matrix
+		 * multiplication is split between threads
+		 */
+		const size_t PARALLEL_MIN_WORK = 128 * 128 * 128;
+
+		/**
+		 * Task run on a range of items, given the first
+		 * item and one past the last item
+		 */
+		typedef std::function<void(size_t, size_t)> range_task;
+
+		/**
+		 * Set the number of threads used for large
+		 * operations, including the calling thread.
+		 * It takes effect at the next operation.
+		 * @param count Number of threads, or 0 for one
+		 * per hardware thread (the default)
+		 */
+		void set_thread_count(size_t count);
+
+		/**
+		 * Get the number of threads used for large
+		 * operations, including the calling thread.
+		 * @return Number of threads
+		 */
+		size_t thread_count();
+
+		/**
+		 * Split the items from 0 to count into ranges and
+		 * run the task on each range, using the threads
+		 * of the pool. Every range except the last is a
+		 * multiple of the granularity. The calling thread
+		 * runs ranges too, and returns when all of them
+		 * are done. Everything runs on the calling thread
+		 * if there is only one thread, if there are too
+		 * few items for two ranges, or if the pool is
+		 * already in use (for example, by a task calling
+		 * this function).
+		 * @param count Number of items
+		 * @param granularity Number of items that ranges
+		 * are multiples of (at least 1)
+		 * @param task Task to run, which must give the same
+		 * result for each item however they are split
+		 * @throw Any exception thrown by the task (the
+		 * first one, if there are several)
+		 */
+		void for_ranges(size_t count, size_t granularity, const range_task& task);
+
+		/**
+		 * Split the items from 0 to count into chunks of
+		 * the given size and run the task on each chunk.
+		 * Threads claim chunks one at a time as they
+		 * finish, so work is balanced even if some chunks
+		 * take much longer than others. Everything runs on
+		 * the calling thread in one call in the same cases
+		 * as for_ranges().
+		 * @param count Number of items
+		 * @param chunk_size Number of items per chunk
+		 * (at least 1)
+		 * @param task Task to run, which must give the same
+		 * result for each item however they are split
+		 * @throw Any exception thrown by the task (the
+		 * first one, if there are several)
+		 */
+		void for_chunks(size_t count, size_t chunk_size, const range_task& task);
+	}
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "rng.h"
+#include <cstdint>
+
+using std::uint64_t;
+
+namespace lapiday {
+	namespace rng {
+		/**
+		 * Step of the SplitMix64 counter
+		 * (2^64 divided by the golden ratio)
+		 */
+		const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+		uint64_t mix(uint64_t x) {
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+			return x ^ (x >> 31);
+		}
+
+		splitmix::splitmix(uint64_t seed, uint64_t level, uint64_t index) {
+			//Mix in one part of the key at a time, so that
+			//no two keys are likely to start the same
+			_state = mix(seed + GOLDEN_GAMMA);
+			_state = mix(_state ^ (level + GOLDEN_GAMMA));
+			_state = mix(_state ^ (index + GOLDEN_GAMMA));
+		}
+
+		uint64_t splitmix::next() {
+			_state += GOLDEN_GAMMA;
+			return mix(_state);
+		}
+
+		double splitmix::uniform() {
+			//Top 53 bits, the precision of a double
+			return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef LAPIDAY_RNG_H
+#define LAPIDAY_RNG_H
+
+#include <cstddef>
+#include <cstdint>
+
+using std::size_t;
+
+/**
+ * Random numbers that depend only on a key,
+ * not on how many numbers were drawn before
+ * or on which thread draws them.
+ */
+namespace lapiday {
+	namespace rng {
+		/**
+		 * Scramble the bits of a number (the
+		 * SplitMix64 output function). Nearby
+		 * inputs give unrelated outputs.
+		 * @param x Number to scramble
+		 * @return Scrambled number
+		 */
+		std::uint64_t mix(std::uint64_t x);
+
+		/**
+		 * SplitMix64 generator started from a key made
+		 * of a seed and the position of a line (its
+		 * level and its index in the level). The same
+		 * key always gives the same numbers, so a line's
+		 * random values can be drawn in any order, on
+		 * any thread.
+		 */
+		class splitmix {
+		public:
+			/**
+			 * Start the generator for a line.
+			 * @param seed Seed of the whole snowflake
+			 * @param level Level of the line
+			 * @param index Index of the line in its level
+			 */
+			splitmix(std::uint64_t seed, std::uint64_t level, std::uint64_t index);
+
+			/**
+			 * Draw the next 64 random bits.
+			 * @return Random number
+			 */
+			std::uint64_t next();
+
+			/**
+			 * Draw the next random number from 0 to 1,
+			 * with 53 random bits.
+			 * @return Random number, at least 0
+			 * and less than 1
+			 */
+			double uniform();
+		private:
+			/**
+			 * Counter, advanced by a fixed step
+			 * for each number
+			 */
+			std::uint64_t _state;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "rules.h"
+#include "affine.h"
+#include "snowflake.h"
+#include "rng.h"
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using std::size_t;
+using std::uint64_t;
+using std::cos;
+using std::sin;
+using std::vector;
+using std::copy;
+
+namespace lapiday {
+	namespace snowflake {
+		template<class T>
+		basic_rule_set<T>::basic_rule_set(const basic_affine<T>* children, size_t child_count)
+			: _kind(rule_table), _child_count(child_count), _table(children, children + child_count),
+			_pairs(0), _min_scale(0), _max_scale(0), _cos(1), _sin(0), _seed(0) {
+		}
+
+		template<class T>
+		basic_rule_set<T>::basic_rule_set(rule_kind kind, size_t child_count)
+			: _kind(kind), _child_count(child_count),
+			_pairs(0), _min_scale(0), _max_scale(0), _cos(1), _sin(0), _seed(0) {
+		}
+
+		template<class T>
+		basic_rule_set<T> basic_rule_set<T>::koch() {
+			const double PI = 3.141592653589793;
+			const double THIRD = 1.0 / 3;
+			//Built in double, then rounded once
+			const basic_affine<T> children[7] = {
+				basic_affine<T>(scale(THIRD)),
+				basic_affine<T>(translate(0, THIRD) * scale(THIRD)),
+				basic_affine<T>(translate(0, 2 * THIRD) * scale(THIRD)),
+				basic_affine<T>(translate(0, THIRD) * rotate(PI / 3) * scale(THIRD)),
+				basic_affine<T>(translate(0, THIRD) * rotate(-PI / 3) * scale(THIRD)),
+				basic_affine<T>(translate(0, 2 * THIRD) * rotate(PI / 3) * scale(THIRD)),
+				basic_affine<T>(translate(0, 2 * THIRD) * rotate(-PI / 3) * scale(THIRD))
+			};
+			return basic_rule_set(children, 7);
+		}
+
+		template<class T>
+		basic_rule_set<T> basic_rule_set<T>::branching(unsigned int pairs, double min_scale, double max_scale, double angle, uint64_t seed) {
+			basic_rule_set rules(rule_branching, 2 * pairs);
+			rules._pairs = pairs;
+			rules._min_scale = min_scale;
+			rules._max_scale = max_scale;
+			rules._cos = cos(angle);
+			rules._sin = sin(angle);
+			rules._seed = seed;
+			return rules;
+		}
+
+		template<class T>
+		rule_kind basic_rule_set<T>::kind() const {
+			return _kind;
+		}
+
+		template<class T>
+		size_t basic_rule_set<T>::child_count() const {
+			return _child_count;
+		}
+
+		template<class T>
+		const basic_affine<T>* basic_rule_set<T>::table() const {
+			return (_kind == rule_table) ? _table.data() : NULL;
+		}
+
+		template<class T>
+		void basic_rule_set<T>::children(size_t level, size_t index, basic_affine<T>* out) const {
+			if(_kind == rule_table) {
+				copy(_table.begin(), _table.end(), out);
+				return;
+			}
+			rng::splitmix numbers(_seed, level, index);
+			for(unsigned int k = 0; k < _pairs; k++) {
+				//Distance from parent line (0 to 1), in the k-th part
+				double distance = (numbers.uniform() + k) / _pairs;
+				//Scale factor
+				double s = _min_scale + numbers.uniform() * (_max_scale - _min_scale);
+				//Entries of translate(0, distance) * rotate(+-angle) * scale(s)
+				double c = s * _cos;
+				double sn = s * _sin;
+				out[2 * k] = basic_affine<T>(c, -sn, 0, sn, c, distance);
+				out[2 * k + 1] = basic_affine<T>(c, sn, 0, -sn, c, distance);
+			}
+		}
+
+		template class basic_rule_set<float>;
+		template class basic_rule_set<double>;
+	}
+}
@@ -0,0 +1,263 @@
+#ifndef LAPIDAY_RULES_H
+#define LAPIDAY_RULES_H
+
+#include "affine.h"
+#include "snowflake.h"
+#include "rng.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::size_t;
+
+namespace lapiday {
+	namespace snowflake {
+		/**
+		 * Kind of rule set
+		 */
+		enum rule_kind {
+			/**
+			 * Every line has the same children,
+			 * stored in a table
+			 */
+			rule_table,
+
+			/**
+			 * Pairs of branches at random distances
+			 * along the line, one rotated each way,
+			 * with random scales
+			 */
+			rule_branching
+		};
+
+		/**
+		 * Rules giving the children of a line. The
+		 * transformations are built when the rule set
+		 * is made (for a table) or straight from their
+		 * entries (for branching), so growing a snowflake
+		 * only needs one product per child.
+		 * Only float and double rule sets are supported;
+		 * rule_set is the double version.
+		 */
+		template<class T>
+		class basic_rule_set {
+		public:
+			/**
+			 * Create a rule set giving every line the
+			 * same children.
+			 * @param children Transformations from a
+			 * line to each of its children (copied)
+			 * @param child_count Number of children
+			 */
+			basic_rule_set(const basic_affine<T>* children, size_t child_count);
+
+			/**
+			 * Create the rule set of the nonrandom
+			 * snowflake: three thirds of the line,
+			 * and branches at 1/3 and 2/3 of the way
+			 * along it, rotated by PI / 3 each way.
+			 * @return Rule set with 7 children
+			 */
+			static basic_rule_set koch();
+
+			/**
+			 * Create the rule set of the random
+			 * snowflake. Each pair of branches is at
+			 * a random distance in its own part of
+			 * the line, and has a random scale.
+			 * The random numbers come from
+			 * rng::splitmix, keyed by the seed and
+			 * the position of the line.
+			 * @param pairs Number of pairs of branches
+			 * @param min_scale Smallest scale of a branch
+			 * @param max_scale Largest scale of a branch
+			 * @param angle Angle of the branches from
+			 * the line, in radians
+			 * @param seed Seed of the random numbers
+			 * @return Rule set with 2 * pairs children
+			 */
+			static basic_rule_set branching(unsigned int pairs, double min_scale, double max_scale, double angle, std::uint64_t seed);
+
+			/**
+			 * Get the kind of this rule set.
+			 * @return Kind
+			 */
+			rule_kind kind() const;
+
+			/**
+			 * Get the number of children of each line.
+			 * @return Number of children
+			 */
+			size_t child_count() const;
+
+			/**
+			 * Get the children given to every line.
+			 * @return Transformations from a line to
+			 * each of its children, or NULL if they
+			 * depend on the line
+			 */
+			const basic_affine<T>* table() const;
+
+			/**
+			 * Find the children of the line at the
+			 * given position. It is safe to call from
+			 * several threads at once.
+			 * @param level Level of the line
+			 * @param index Index of the line in its level
+			 * @param out Array for the transformations
+			 * from the line to each of its children
+			 */
+			void children(size_t level, size_t index, basic_affine<T>* out) const;
+		private:
+			/**
+			 * Kind of rule set
+			 */
+			rule_kind _kind;
+
+			/**
+			 * Number of children
+			 */
+			size_t _child_count;
+
+			/**
+			 * Children of every line (for a table)
+			 */
+			std::vector<basic_affine<T> > _table;
+
+			/**
+			 * Number of pairs of branches
+			 */
+			unsigned int _pairs;
+
+			/**
+			 * Smallest scale of a branch
+			 */
+			double _min_scale;
+
+			/**
+			 * Largest scale of a branch
+			 */
+			double _max_scale;
+
+			/**
+			 * Cosine of the branch angle
+			 */
+			double _cos;
+
+			/**
+			 * Sine of the branch angle
+			 */
+			double _sin;
+
+			/**
+			 * Seed of the random numbers
+			 */
+			std::uint64_t _seed;
+
+			/**
+			 * Create an empty rule set.
+			 * @param kind Kind of rule set
+			 * @param child_count Number of children
+			 */
+			basic_rule_set(rule_kind kind, size_t child_count);
+		};
+
+		/**
+		 * Rule set for lines with double transformations
+		 */
+		typedef basic_rule_set<double> rule_set;
+
+		/**
+		 * Sum the rest of a Taylor series whose terms
+		 * are multiplied by -x^2 / ((n + 1)(n + 2)),
+		 * for static_sin() and static_cos().
+		 * @param x2 Square of the angle
+		 * @param term Current term
+		 * @param n Power of the angle in the current term
+		 * @return Sum of the current and later terms
+		 */
+		constexpr double taylor_rest(double x2, double term, int n) {
+			return ((term < 1e-18) && (term > -1e-18)) ? 0 : term + taylor_rest(x2, -term * x2 / ((n + 1) * (n + 2)), n + 2);
+		}
+
+		/**
+		 * Find the sine of an angle at compile time.
+		 * @param x Angle in radians (from -PI to PI,
+		 * for accuracy)
+		 * @return Sine
+		 */
+		constexpr double static_sin(double x) {
+			return taylor_rest(x * x, x, 1);
+		}
+
+		/**
+		 * Find the cosine of an angle at compile time.
+		 * @param x Angle in radians (from -PI to PI,
+		 * for accuracy)
+		 * @return Cosine
+		 */
+		constexpr double static_cos(double x) {
+			return taylor_rest(x * x, 1, 0);
+		}
+
+		/**
+		 * Rule set of the random snowflake, like
+		 * rule_set::branching(), with the parameters
+		 * fixed at compile time. The number of children
+		 * is a constant, so the loop over the children
+		 * can be unrolled, and the sine and cosine of
+		 * the angle are found by the compiler.
+		 * Params must have static constexpr members
+		 * PAIRS (unsigned int), MIN_SCALE, MAX_SCALE
+		 * and ANGLE (double).
+		 * Only float and double rule sets are supported.
+		 */
+		template<class T, class Params>
+		class basic_static_branching {
+		public:
+			/**
+			 * Number of children of each line
+			 */
+			static const size_t CHILD_COUNT = 2 * Params::PAIRS;
+
+			/**
+			 * Create the rule set.
+			 * @param seed Seed of the random numbers
+			 */
+			explicit basic_static_branching(std::uint64_t seed) : _seed(seed) {
+			}
+
+			/**
+			 * Find the children of the line at the
+			 * given position, which are the same as
+			 * from rule_set::branching() with the same
+			 * parameters (up to rounding of the sine
+			 * and cosine).
+			 * @param level Level of the line
+			 * @param index Index of the line in its level
+			 * @param out Array for the transformations
+			 * from the line to each of its children
+			 */
+			void children(size_t level, size_t index, basic_affine<T>* out) const {
+				const double COS = static_cos(Params::ANGLE);
+				const double SIN = static_sin(Params::ANGLE);
+				rng::splitmix numbers(_seed, level, index);
+				for(unsigned int k = 0; k < Params::PAIRS; k++) {
+					double distance = (numbers.uniform() + k) / Params::PAIRS;
+					double s = Params::MIN_SCALE + numbers.uniform() * (Params::MAX_SCALE - Params::MIN_SCALE);
+					double c = s * COS;
+					double sn = s * SIN;
+					out[2 * k] = basic_affine<T>(c, -sn, 0, sn, c, distance);
+					out[2 * k + 1] = basic_affine<T>(c, sn, 0, -sn, c, distance);
+				}
+			}
+		private:
+			/**
+			 * Seed of the random numbers
+			 */
+			std::uint64_t _seed;
+		};
+	}
+}
+
+#endif
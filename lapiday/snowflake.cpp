@@ -1,40 +1,112 @@
 #include "snowflake.h"
 #include "matrix.h"
+#include "affine.h"
+#include "parallel.h"
 #include <cmath>
+#include <vector>
 
 using namespace std;
 
 namespace lapiday {
-	using matrix::matrix;
+	using matrix::affine;
+	using matrix::basic_affine;
 
 	namespace snowflake {
-		line::line(const matrix& t, bool c) {
+		template<class T>
+		basic_line<T>::basic_line(const basic_affine<T>& t) {
 			transformation = t;
-			completed = c;
 		}
 
-		matrix scale(double factor) {
-			matrix temp(3);
-			temp(0, 0) = factor;
-			temp(1, 1) = factor;
-			//(2, 2) remains 1
-			return temp;
+		template<class T>
+		T basic_line<T>::length() const {
+			const T* t = transformation.data();
+			return sqrt(t[1] * t[1] + t[4] * t[4]);
 		}
 
-		matrix translate(double x, double y) {
-			matrix temp(3);
-			temp(0, 2) = x;
-			temp(1, 2) = y;
-			return temp;
+		affine scale(double factor) {
+			return affine(
+				factor, 0, 0,
+				0, factor, 0
+			);
 		}
 
-		matrix rotate(double angle) {
-			matrix temp(3);
-			temp(0, 0) = cos(angle);
-			temp(0, 1) = -sin(angle);
-			temp(1, 0) = sin(angle);
-			temp(1, 1) = cos(angle);
-			return temp;
+		affine translate(double x, double y) {
+			return affine(
+				1, 0, x,
+				0, 1, y
+			);
 		}
+
+		affine rotate(double angle) {
+			double c = cos(angle);
+			double s = sin(angle);
+			return affine(
+				c, -s, 0,
+				s, c, 0
+			);
+		}
+
+		affine reflect() {
+			return affine(
+				-1, 0, 0,
+				0, 1, 0
+			);
+		}
+
+		vector<affine> symmetry(unsigned int fold, bool mirror) {
+			const double TWO_PI = 6.283185307179586;
+			vector<affine> instances;
+			instances.reserve(mirror ? 2 * fold : fold);
+			for(unsigned int i = 0; i < fold; i++) {
+				instances.push_back(rotate(TWO_PI * i / fold));
+			}
+			if(mirror) {
+				for(unsigned int i = 0; i < fold; i++) {
+					instances.push_back(instances[i] * reflect());
+				}
+			}
+			return instances;
+		}
+
+		template<class T>
+		void endpoints(const basic_line<T>* lines, size_t count, T* x0, T* y0, T* x1, T* y1) {
+			for(size_t i = 0; i < count; i++) {
+				const T* t = lines[i].transformation.data();
+				//Image of (0, 0) is the last column,
+				//and (0, 1) adds the second column
+				x0[i] = t[2];
+				y0[i] = t[5];
+				x1[i] = t[1] + t[2];
+				y1[i] = t[4] + t[5];
+			}
+		}
+
+		template<class T>
+		void expand(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, size_t child_count, basic_line<T>* out) {
+			expand_lines(parents, count, children, child_count, out);
+		}
+
+		template<class T>
+		void expand_parallel(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, size_t child_count, basic_line<T>* out) {
+			if(count <= EXPAND_CHUNK) {
+				expand(parents, count, children, child_count, out);
+				return;
+			}
+			parallel::for_chunks(count, EXPAND_CHUNK, [=](size_t begin, size_t end) {
+				expand(parents + begin, end - begin, children, child_count, out + begin * child_count);
+			});
+		}
+
+		template class basic_line<float>;
+		template class basic_line<double>;
+
+		template void endpoints(const basic_line<float>* lines, size_t count, float* x0, float* y0, float* x1, float* y1);
+		template void endpoints(const basic_line<double>* lines, size_t count, double* x0, double* y0, double* x1, double* y1);
+
+		template void expand(const basic_line<float>* parents, size_t count, const basic_affine<float>* children, size_t child_count, basic_line<float>* out);
+		template void expand(const basic_line<double>* parents, size_t count, const basic_affine<double>* children, size_t child_count, basic_line<double>* out);
+
+		template void expand_parallel(const basic_line<float>* parents, size_t count, const basic_affine<float>* children, size_t child_count, basic_line<float>* out);
+		template void expand_parallel(const basic_line<double>* parents, size_t count, const basic_affine<double>* children, size_t child_count, basic_line<double>* out);
 	}
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 #define LAPIDAY_SNOWFLAKE_H
 
 #include "matrix.h"
+#include "affine.h"
+#include <cstddef>
+#include <vector>
+
+using std::size_t;
 
 namespace lapiday {
 	/**
@@ -10,23 +15,35 @@ namespace lapiday {
 	 * an additional final component of value 1.
 	 */
 	namespace snowflake {
+		using matrix::basic_affine;
+		using matrix::affine;
 		using matrix::matrix;
 		/**
 		 * Line with transformation from
 		 * a base, a line from (0, 0)
-		 * to (0, 1).
+		 * to (0, 1). Only float and double
+		 * transformations are supported;
+		 * line is the double version.
 		 */
-		class line {
+		template<class T>
+		class basic_line {
 		public:
 			/**
 			 * Initialize the line with the
 			 * given members.
 			 * @param t Transformation matrix
-			 * @param c Whether or not the
-			 * transformations for this line
-			 * are completed
 			 */
-			line(const matrix& t = matrix(3), bool c = false);
+			basic_line(const basic_affine<T>& t = basic_affine<T>());
+
+			/**
+			 * Get the length of this line,
+			 * the image of the base line's
+			 * direction (0, 1) under the
+			 * transformation.
+			 * @return Length, in the units
+			 * of the transformation's output
+			 */
+			T length() const;
 
 			/**
 			 * Transformation matrix from
@@ -38,16 +55,14 @@ namespace lapiday {
 			 * line with the transformation
 			 * matrix on the left.
 			 */
-			matrix transformation;
-
-			/**
-			 * Whether or not the
-			 * transformations for this line
-			 * are completed
-			 */
-			bool completed;
+			basic_affine<T> transformation;
 		};
 
+		/**
+		 * Line with a double transformation
+		 */
+		typedef basic_line<double> line;
+
 		/**
 		 * Generate a matrix for scaling
 		 * points about the origin.
@@ -58,7 +73,7 @@ namespace lapiday {
 		 * @return Transformation
 		 * matrix for scaling
 		 */
-		matrix scale(double factor);
+		affine scale(double factor);
 
 		/**
 		 * Generate a matrix for
@@ -74,7 +89,7 @@ namespace lapiday {
 		 * @return Transformation
 		 * matrix for translation
 		 */
-		matrix translate(double x, double y);
+		affine translate(double x, double y);
 
 		/**
 		 * Generate a matrix for
@@ -86,7 +101,174 @@ namespace lapiday {
 		 * @return Transformation
 		 * matrix for rotation
 		 */
-		matrix rotate(double angle);
+		affine rotate(double angle);
+
+		/**
+		 * Generate a matrix for
+		 * reflecting points across
+		 * the y-axis (the base line).
+		 * @return Transformation
+		 * matrix for reflection
+		 */
+		affine reflect();
+
+		/**
+		 * Generate the transformations
+		 * that copy one spoke of a
+		 * snowflake onto every spoke,
+		 * so only one spoke has to be
+		 * generated. The spoke should
+		 * point along the base line.
+		 * @param fold Number of spokes
+		 * @param mirror Whether or not to
+		 * also reflect each copy across
+		 * its spoke (for a spoke with
+		 * only one half generated)
+		 * @return Rotations by multiples
+		 * of 2 PI / fold, starting with
+		 * the identity, followed by the
+		 * reflected rotations if mirror
+		 * is true
+		 */
+		std::vector<affine> symmetry(unsigned int fold, bool mirror = false);
+
+		/**
+		 * Find the endpoints of many lines
+		 * at once, as separate arrays of
+		 * coordinates.
+		 * @param lines Lines
+		 * @param count Number of lines
+		 * @param x0 Array for the x-coordinates
+		 * of the first endpoints, the images
+		 * of (0, 0)
+		 * @param y0 Array for the y-coordinates
+		 * of the first endpoints
+		 * @param x1 Array for the x-coordinates
+		 * of the second endpoints, the images
+		 * of (0, 1)
+		 * @param y1 Array for the y-coordinates
+		 * of the second endpoints
+		 */
+		template<class T>
+		void endpoints(const basic_line<T>* lines, size_t count, T* x0, T* y0, T* x1, T* y1);
+
+		/**
+		 * Create the children of many lines
+		 * at once. Every parent is combined
+		 * with every child transformation
+		 * (parent transformation on the left),
+		 * and the results are stored in
+		 * order: all children of the first
+		 * parent, then all children of the
+		 * second parent, and so on.
+		 * @param parents Parent lines
+		 * @param count Number of parent lines
+		 * @param children Transformations from
+		 * a parent to each of its children
+		 * @param child_count Number of children
+		 * per parent
+		 * @param out Array for the new lines,
+		 * with room for count * child_count
+		 * lines (it must not overlap the parents)
+		 */
+		template<class T>
+		void expand(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, size_t child_count, basic_line<T>* out);
+
+		/**
+		 * Number of parent lines in each chunk
+		 * claimed by a thread in expand_parallel()
+		 */
+		const size_t EXPAND_CHUNK = 1024;
+
+		/**
+		 * Create the children of many lines
+		 * at once, like expand(), splitting
+		 * the parents into chunks shared
+		 * between the threads of the pool.
+		 * Each chunk writes its own part of
+		 * the output, so the result is the
+		 * same as with expand().
+		 * @param parents Parent lines
+		 * @param count Number of parent lines
+		 * @param children Transformations from
+		 * a parent to each of its children
+		 * @param child_count Number of children
+		 * per parent
+		 * @param out Array for the new lines,
+		 * with room for count * child_count
+		 * lines (it must not overlap the parents)
+		 */
+		template<class T>
+		void expand_parallel(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, size_t child_count, basic_line<T>* out);
+
+		/**
+		 * Create the children of many lines
+		 * at once, like expand(), with the
+		 * number of children known at compile
+		 * time so the loop over them can be
+		 * unrolled.
+		 * @param parents Parent lines
+		 * @param count Number of parent lines
+		 * @param children Transformations from
+		 * a parent to each of its children
+		 * (CHILD_COUNT of them)
+		 * @param out Array for the new lines,
+		 * with room for count * CHILD_COUNT
+		 * lines (it must not overlap the parents)
+		 */
+		template<size_t CHILD_COUNT, class T>
+		void expand_static(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, basic_line<T>* out);
+
+		/**
+		 * Create the children of many lines
+		 * at once. This is the body of both
+		 * expand() and expand_static(); it is
+		 * inline so that a child count known
+		 * at compile time is folded into the
+		 * loop over the children.
+		 * @param parents Parent lines
+		 * @param count Number of parent lines
+		 * @param children Transformations from
+		 * a parent to each of its children
+		 * @param child_count Number of children
+		 * per parent
+		 * @param out Array for the new lines,
+		 * with room for count * child_count
+		 * lines (it must not overlap the parents)
+		 */
+		template<class T>
+		inline void expand_lines(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, size_t child_count, basic_line<T>* out) {
+			//The output is an array of lines, so the children
+			//of each parent are written in turn (blocks of
+			//parents with their entries transposed need the
+			//products transposed back, which is slower)
+			for(size_t i = 0; i < count; i++) {
+				const T* p = parents[i].transformation.data();
+				T p0 = p[0];
+				T p1 = p[1];
+				T p2 = p[2];
+				T p3 = p[3];
+				T p4 = p[4];
+				T p5 = p[5];
+				basic_line<T>* o = out + i * child_count;
+				for(size_t k = 0; k < child_count; k++) {
+					//Same arithmetic as affine multiplication
+					const T* c = children[k].data();
+					T* r = o[k].transformation.data();
+					r[0] = p0 * c[0] + p1 * c[3];
+					r[1] = p0 * c[1] + p1 * c[4];
+					r[2] = p0 * c[2] + p1 * c[5] + p2;
+					r[3] = p3 * c[0] + p4 * c[3];
+					r[4] = p3 * c[1] + p4 * c[4];
+					r[5] = p3 * c[2] + p4 * c[5] + p5;
+				}
+			}
+		}
+
+		template<size_t CHILD_COUNT, class T>
+		inline void expand_static(const basic_line<T>* parents, size_t count, const basic_affine<T>* children, basic_line<T>* out) {
+			expand_lines(parents, count, children, CHILD_COUNT, out);
+		}
 	}
 }
 
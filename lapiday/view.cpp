@@ -0,0 +1,253 @@
+#include "view.h"
+#include "matrix.h"
+#include "gemm.h"
+#include <cstddef>
+#include <stdexcept>
+#include <iostream>
+
+using std::size_t;
+using std::invalid_argument;
+using std::out_of_range;
+using std::ostream;
+
+namespace lapiday {
+	namespace matrix {
+		template<class T>
+		basic_const_matrix_view<T>::basic_const_matrix_view(const T* entries, size_t rows, size_t cols, size_t row_stride, size_t col_stride) {
+			_entries = entries;
+			_rows = rows;
+			_cols = cols;
+			_row_stride = row_stride;
+			_col_stride = col_stride;
+		}
+
+		template<class T>
+		basic_const_matrix_view<T>::basic_const_matrix_view(const basic_matrix<T>& m) {
+			*this = m.view();
+		}
+
+		template<class T>
+		size_t basic_const_matrix_view<T>::rows() const {
+			return _rows;
+		}
+
+		template<class T>
+		size_t basic_const_matrix_view<T>::cols() const {
+			return _cols;
+		}
+
+		template<class T>
+		size_t basic_const_matrix_view<T>::row_stride() const {
+			return _row_stride;
+		}
+
+		template<class T>
+		size_t basic_const_matrix_view<T>::col_stride() const {
+			return _col_stride;
+		}
+
+		template<class T>
+		const T* basic_const_matrix_view<T>::data() const {
+			return _entries;
+		}
+
+		template<class T>
+		T basic_const_matrix_view<T>::operator()(size_t i, size_t j) const {
+			if((i < _rows) && (j < _cols)) {
+				return _entries[i * _row_stride + j * _col_stride];
+			} else {
+				throw out_of_range("Element index out of range");
+			}
+		}
+
+		template<class T>
+		basic_const_matrix_view<T> basic_const_matrix_view<T>::block(size_t i, size_t j, size_t rows, size_t cols) const {
+			return basic_const_matrix_view<T>(_entries + _block_offset(i, j, rows, cols), rows, cols, _row_stride, _col_stride);
+		}
+
+		template<class T>
+		basic_const_matrix_view<T> basic_const_matrix_view<T>::row(size_t i) const {
+			return block(i, 0, 1, _cols);
+		}
+
+		template<class T>
+		basic_const_matrix_view<T> basic_const_matrix_view<T>::col(size_t j) const {
+			return block(0, j, _rows, 1);
+		}
+
+		template<class T>
+		basic_const_matrix_view<T> basic_const_matrix_view<T>::transpose() const {
+			return basic_const_matrix_view<T>(_entries, _cols, _rows, _col_stride, _row_stride);
+		}
+
+		template<class T>
+		size_t basic_const_matrix_view<T>::_block_offset(size_t i, size_t j, size_t rows, size_t cols) const {
+			//Written to avoid overflow in i + rows
+			if((i > _rows) || (rows > _rows - i) || (j > _cols) || (cols > _cols - j)) {
+				throw invalid_argument("Block out of range");
+			}
+			if((rows == 0) || (cols == 0)) {
+				//Entry (i, j) may be past the end
+				return 0;
+			}
+			return i * _row_stride + j * _col_stride;
+		}
+
+		template<class T>
+		bool basic_const_matrix_view<T>::_equals(const basic_const_matrix_view<T>& v) const {
+			if((_rows != v._rows) || (_cols != v._cols)) {
+				//Different sizes
+				return false;
+			}
+			for(size_t i = 0; i < _rows; i++) {
+				for(size_t j = 0; j < _cols; j++) {
+					if(_entries[i * _row_stride + j * _col_stride] != v._entries[i * v._row_stride + j * v._col_stride]) {
+						return false;
+					}
+				}
+			}
+			//Did not return in loop
+			return true;
+		}
+
+		template<class T>
+		void basic_const_matrix_view<T>::_write(ostream& out) const {
+			if((_rows > 0) && (_cols > 0)) {
+				for(size_t i = 0; i < _rows; i++) {
+					const T* row = _entries + i * _row_stride;
+					out << row[0];
+					for(size_t j = 1; j < _cols; j++) {
+						out << ", " << row[j * _col_stride];
+					}
+					out << '\n';
+				}
+			} else {
+				out << "[]\n";
+			}
+		}
+
+		template<class T>
+		basic_matrix_view<T>::basic_matrix_view(T* entries, size_t rows, size_t cols, size_t row_stride, size_t col_stride)
+			: basic_const_matrix_view<T>(entries, rows, cols, row_stride, col_stride) {
+		}
+
+		template<class T>
+		basic_matrix_view<T>::basic_matrix_view(basic_matrix<T>& m) : basic_const_matrix_view<T>(m.view()) {
+		}
+
+		template<class T>
+		T* basic_matrix_view<T>::data() const {
+			//The entries were writable when the view was made
+			return const_cast<T*>(this->_entries);
+		}
+
+		template<class T>
+		T& basic_matrix_view<T>::operator()(size_t i, size_t j) const {
+			if((i < this->_rows) && (j < this->_cols)) {
+				return data()[i * this->_row_stride + j * this->_col_stride];
+			} else {
+				throw out_of_range("Element index out of range");
+			}
+		}
+
+		template<class T>
+		basic_matrix_view<T> basic_matrix_view<T>::block(size_t i, size_t j, size_t rows, size_t cols) const {
+			return basic_matrix_view<T>(data() + this->_block_offset(i, j, rows, cols), rows, cols, this->_row_stride, this->_col_stride);
+		}
+
+		template<class T>
+		basic_matrix_view<T> basic_matrix_view<T>::row(size_t i) const {
+			return block(i, 0, 1, this->_cols);
+		}
+
+		template<class T>
+		basic_matrix_view<T> basic_matrix_view<T>::col(size_t j) const {
+			return block(0, j, this->_rows, 1);
+		}
+
+		template<class T>
+		basic_matrix_view<T> basic_matrix_view<T>::transpose() const {
+			return basic_matrix_view<T>(data(), this->_cols, this->_rows, this->_col_stride, this->_row_stride);
+		}
+
+		template<class T>
+		const basic_matrix_view<T>& basic_matrix_view<T>::assign(const basic_const_matrix_view<T>& v) const {
+			if((this->_rows != v.rows()) || (this->_cols != v.cols())) {
+				throw invalid_argument("Views are not the same size");
+			}
+			T* entries = data();
+			const T* source = v.data();
+			size_t source_row_stride = v.row_stride();
+			size_t source_col_stride = v.col_stride();
+			for(size_t i = 0; i < this->_rows; i++) {
+				for(size_t j = 0; j < this->_cols; j++) {
+					entries[i * this->_row_stride + j * this->_col_stride] = source[i * source_row_stride + j * source_col_stride];
+				}
+			}
+			return *this;
+		}
+
+		template<class T>
+		const basic_matrix_view<T>& basic_matrix_view<T>::fill(T value) const {
+			T* entries = data();
+			for(size_t i = 0; i < this->_rows; i++) {
+				for(size_t j = 0; j < this->_cols; j++) {
+					entries[i * this->_row_stride + j * this->_col_stride] = value;
+				}
+			}
+			return *this;
+		}
+
+		template<class T>
+		const basic_matrix_view<T>& basic_matrix_view<T>::operator +=(const basic_const_matrix_view<T>& v) const {
+			_add(v, 1);
+			return *this;
+		}
+
+		template<class T>
+		const basic_matrix_view<T>& basic_matrix_view<T>::operator -=(const basic_const_matrix_view<T>& v) const {
+			_add(v, -1);
+			return *this;
+		}
+
+		template<class T>
+		const basic_matrix_view<T>& basic_matrix_view<T>::operator *=(T scalar) const {
+			T* entries = data();
+			for(size_t i = 0; i < this->_rows; i++) {
+				for(size_t j = 0; j < this->_cols; j++) {
+					entries[i * this->_row_stride + j * this->_col_stride] *= scalar;
+				}
+			}
+			return *this;
+		}
+
+		template<class T>
+		const basic_matrix_view<T>& basic_matrix_view<T>::operator /=(T scalar) const {
+			if(scalar == 0) {
+				throw invalid_argument("Division by zero scalar");
+			}
+			return operator *=(1 / scalar);
+		}
+
+		template<class T>
+		void basic_matrix_view<T>::_add(const basic_const_matrix_view<T>& v, T multiplier) const {
+			if((this->_rows != v.rows()) || (this->_cols != v.cols())) {
+				throw invalid_argument("Views are not the same size");
+			}
+			T* entries = data();
+			const T* source = v.data();
+			size_t source_row_stride = v.row_stride();
+			size_t source_col_stride = v.col_stride();
+			for(size_t i = 0; i < this->_rows; i++) {
+				for(size_t j = 0; j < this->_cols; j++) {
+					entries[i * this->_row_stride + j * this->_col_stride] += multiplier * source[i * source_row_stride + j * source_col_stride];
+				}
+			}
+		}
+
+		template class basic_const_matrix_view<float>;
+		template class basic_const_matrix_view<double>;
+		template class basic_matrix_view<float>;
+		template class basic_matrix_view<double>;
+	}
+}
@@ -0,0 +1,425 @@
+#ifndef LAPIDAY_VIEW_H
+#define LAPIDAY_VIEW_H
+
+#include "matrix.h"
+#include <cstddef>
+#include <stdexcept>
+#include <iostream>
+
+using std::size_t;
+using std::invalid_argument;
+using std::out_of_range;
+using std::ostream;
+
+namespace lapiday {
+	namespace matrix {
+		/**
+		* Read-only view of entries owned by something else
+		* (usually a matrix), laid out with a fixed distance
+		* between rows and between columns. Blocks, rows,
+		* columns and transposes of a view are views of the
+		* same entries, so no copying is needed. A view must
+		* not outlive the entries, and is invalidated when
+		* the viewed matrix is resized or moved from.
+		* Only float and double entries are supported;
+		* const_matrix_view is the double version.
+		*/
+		template<class T>
+		class basic_const_matrix_view {
+		public:
+			/**
+			* Create a new view of the given entries.
+			* @param entries First entry
+			* @param rows Number of rows
+			* @param cols Number of columns
+			* @param row_stride Distance between rows
+			* @param col_stride Distance between columns
+			*/
+			basic_const_matrix_view(const T* entries, size_t rows, size_t cols, size_t row_stride, size_t col_stride);
+
+			/**
+			* Create a new view of all entries of the given
+			* matrix.
+			* @param m Matrix to view
+			*/
+			basic_const_matrix_view(const basic_matrix<T>& m);
+
+			/**
+			* Get the number of rows of this view.
+			* @return Number of rows
+			*/
+			size_t rows() const;
+
+			/**
+			* Get the number of columns of this view.
+			* @return Number of columns
+			*/
+			size_t cols() const;
+
+			/**
+			* Get the distance between rows of this view.
+			* @return Row stride
+			*/
+			size_t row_stride() const;
+
+			/**
+			* Get the distance between columns of this view.
+			* @return Column stride
+			*/
+			size_t col_stride() const;
+
+			/**
+			* Get the first entry of this view.
+			* @return Pointer to entry (0, 0)
+			*/
+			const T* data() const;
+
+			/**
+			* Get the entry at the given position.
+			* @param i Row (zero-based)
+			* @param j Column (zero-based)
+			* @return Entry
+			* @throw out_of_range If the row or column
+			* is not in the range of this view
+			*/
+			T operator()(size_t i, size_t j) const;
+
+			/**
+			* Get a view of a rectangular block of this view.
+			* @param i First row (zero-based)
+			* @param j First column (zero-based)
+			* @param rows Number of rows
+			* @param cols Number of columns
+			* @return View of the block
+			* @throw invalid_argument If the block does not
+			* fit in this view
+			*/
+			basic_const_matrix_view block(size_t i, size_t j, size_t rows, size_t cols) const;
+
+			/**
+			* Get a view of one row of this view.
+			* @param i Row (zero-based)
+			* @return One-row view
+			* @throw invalid_argument If the row is not
+			* in the range of this view
+			*/
+			basic_const_matrix_view row(size_t i) const;
+
+			/**
+			* Get a view of one column of this view.
+			* @param j Column (zero-based)
+			* @return One-column view
+			* @throw invalid_argument If the column is not
+			* in the range of this view
+			*/
+			basic_const_matrix_view col(size_t j) const;
+
+			/**
+			* Get a view of the transpose of this view.
+			* @return Transposed view
+			*/
+			basic_const_matrix_view transpose() const;
+
+			/**
+			* Output the entries of the view to the stream,
+			* in the same format as a matrix.
+			* @param out Stream to output to
+			* @param v View to output
+			* @return The stream
+			*/
+			friend ostream& operator <<(ostream& out, const basic_const_matrix_view& v) {
+				v._write(out);
+				return out;
+			}
+
+			/**
+			* Check if the two views have equal entries.
+			* @param first First view
+			* @param second Second view
+			* @return true if the views are the same size
+			* and have equal entries, false otherwise
+			*/
+			friend bool operator ==(const basic_const_matrix_view& first, const basic_const_matrix_view& second) {
+				return first._equals(second);
+			}
+
+			/**
+			* Check if the two views do not have equal entries.
+			* @param first First view
+			* @param second Second view
+			* @return true if the views are different sizes
+			* or have different entries, false otherwise
+			*/
+			friend bool operator !=(const basic_const_matrix_view& first, const basic_const_matrix_view& second) {
+				return !first._equals(second);
+			}
+
+			/**
+			* Add the entries of two views.
+			* @param first First view
+			* @param second Second view
+			* @return Sum
+			* @throw invalid_argument If the views are not
+			* the same size
+			*/
+			friend basic_matrix<T> operator +(const basic_const_matrix_view& first, const basic_const_matrix_view& second) {
+				basic_matrix<T> temp(first);
+				temp.view() += second;
+				return temp;
+			}
+
+			/**
+			* Subtract the entries of two views.
+			* @param min Minuend
+			* @param sub Subtrahend
+			* @return Difference
+			* @throw invalid_argument If the views are not
+			* the same size
+			*/
+			friend basic_matrix<T> operator -(const basic_const_matrix_view& min, const basic_const_matrix_view& sub) {
+				basic_matrix<T> temp(min);
+				temp.view() -= sub;
+				return temp;
+			}
+
+			/**@{*/
+			/**
+			* Multiply the entries of a view by a scalar.
+			* @param scalar Scalar
+			* @param v View
+			* @return Product
+			*/
+			friend basic_matrix<T> operator *(T scalar, const basic_const_matrix_view& v) {
+				basic_matrix<T> temp(v);
+				temp.view() *= scalar;
+				return temp;
+			}
+
+			friend basic_matrix<T> operator *(const basic_const_matrix_view& v, T scalar) {
+				return scalar * v;
+			}
+			/**@}*/
+
+			/**
+			* Multiply the matrices of two views.
+			* @param first First factor
+			* @param second Second factor
+			* @return Product
+			* @throw invalid_argument If the matrices
+			* cannot be multiplied in the given order
+			*/
+			friend basic_matrix<T> operator *(const basic_const_matrix_view& first, const basic_const_matrix_view& second) {
+				basic_matrix<T> temp;
+				multiply(first, second, temp);
+				return temp;
+			}
+		protected:
+			/**
+			* First entry
+			*/
+			const T* _entries;
+
+			/**
+			* Number of rows
+			*/
+			size_t _rows;
+
+			/**
+			* Number of columns
+			*/
+			size_t _cols;
+
+			/**
+			* Distance between rows
+			*/
+			size_t _row_stride;
+
+			/**
+			* Distance between columns
+			*/
+			size_t _col_stride;
+
+			/**
+			* Get the offset of a block from the first entry,
+			* after checking that the block fits.
+			* @param i First row (zero-based)
+			* @param j First column (zero-based)
+			* @param rows Number of rows
+			* @param cols Number of columns
+			* @return Offset of entry (i, j), or 0 if the
+			* block is empty
+			* @throw invalid_argument If the block does not
+			* fit in this view
+			*/
+			size_t _block_offset(size_t i, size_t j, size_t rows, size_t cols) const;
+
+			/**
+			* Check if this view has the same entries
+			* as another view.
+			* @param v View to compare with
+			* @return true if the views are the same size
+			* and have equal entries, false otherwise
+			*/
+			bool _equals(const basic_const_matrix_view& v) const;
+
+			/**
+			* Output the entries of this view to the stream,
+			* one row per line.
+			* @param out Stream to output to
+			*/
+			void _write(ostream& out) const;
+		};
+
+		/**
+		* Writable view of entries owned by something else.
+		* Copying the view does not copy the entries, and
+		* the entries can be changed through a const view.
+		* matrix_view is the double version.
+		*/
+		template<class T>
+		class basic_matrix_view : public basic_const_matrix_view<T> {
+		public:
+			/**
+			* Create a new view of the given entries.
+			* @param entries First entry
+			* @param rows Number of rows
+			* @param cols Number of columns
+			* @param row_stride Distance between rows
+			* @param col_stride Distance between columns
+			*/
+			basic_matrix_view(T* entries, size_t rows, size_t cols, size_t row_stride, size_t col_stride);
+
+			/**
+			* Create a new view of all entries of the given
+			* matrix, making its structure general.
+			* @param m Matrix to view
+			*/
+			basic_matrix_view(basic_matrix<T>& m);
+
+			/**
+			* Get the first entry of this view.
+			* @return Pointer to entry (0, 0)
+			*/
+			T* data() const;
+
+			/**
+			* Get the entry at the given position.
+			* @param i Row (zero-based)
+			* @param j Column (zero-based)
+			* @return Entry
+			* @throw out_of_range If the row or column
+			* is not in the range of this view
+			*/
+			T& operator()(size_t i, size_t j) const;
+
+			/**
+			* Get a view of a rectangular block of this view.
+			* @param i First row (zero-based)
+			* @param j First column (zero-based)
+			* @param rows Number of rows
+			* @param cols Number of columns
+			* @return View of the block
+			* @throw invalid_argument If the block does not
+			* fit in this view
+			*/
+			basic_matrix_view block(size_t i, size_t j, size_t rows, size_t cols) const;
+
+			/**
+			* Get a view of one row of this view.
+			* @param i Row (zero-based)
+			* @return One-row view
+			* @throw invalid_argument If the row is not
+			* in the range of this view
+			*/
+			basic_matrix_view row(size_t i) const;
+
+			/**
+			* Get a view of one column of this view.
+			* @param j Column (zero-based)
+			* @return One-column view
+			* @throw invalid_argument If the column is not
+			* in the range of this view
+			*/
+			basic_matrix_view col(size_t j) const;
+
+			/**
+			* Get a view of the transpose of this view.
+			* @return Transposed view
+			*/
+			basic_matrix_view transpose() const;
+
+			/**
+			* Copy the entries of the given view into this
+			* view. The views must not overlap, unless they
+			* are the same.
+			* @param v View to copy
+			* @return This view
+			* @throw invalid_argument If the views are not
+			* the same size
+			*/
+			const basic_matrix_view& assign(const basic_const_matrix_view<T>& v) const;
+
+			/**
+			* Set every entry of this view to the given value.
+			* @param value Value
+			* @return This view
+			*/
+			const basic_matrix_view& fill(T value) const;
+
+			/**
+			* Add the entries of the given view to this view.
+			* @param v View to add
+			* @return This view
+			* @throw invalid_argument If the views are not
+			* the same size
+			*/
+			const basic_matrix_view& operator +=(const basic_const_matrix_view<T>& v) const;
+
+			/**
+			* Subtract the entries of the given view from
+			* this view.
+			* @param v View to subtract
+			* @return This view
+			* @throw invalid_argument If the views are not
+			* the same size
+			*/
+			const basic_matrix_view& operator -=(const basic_const_matrix_view<T>& v) const;
+
+			/**
+			* Multiply the entries of this view by a scalar.
+			* @param scalar Scalar
+			* @return This view
+			*/
+			const basic_matrix_view& operator *=(T scalar) const;
+
+			/**
+			* Divide the entries of this view by a scalar.
+			* @param scalar Scalar
+			* @return This view
+			* @throw invalid_argument If the scalar is zero
+			*/
+			const basic_matrix_view& operator /=(T scalar) const;
+		private:
+			/**
+			* Add a multiple of the given view to this view.
+			* @param v View to add
+			* @param multiplier Multiplier for the entries of v
+			* @throw invalid_argument If the views are not
+			* the same size
+			*/
+			void _add(const basic_const_matrix_view<T>& v, T multiplier) const;
+		};
+
+		/**
+		* Read-only view of doubles
+		*/
+		typedef basic_const_matrix_view<double> const_matrix_view;
+
+		/**
+		* Writable view of doubles
+		*/
+		typedef basic_matrix_view<double> matrix_view;
+	}
+}
+
+#endif
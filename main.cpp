@@ -1,5 +1,7 @@
 #include "matrix.h"
 #include "snowflake.h"
+#include "generator.h"
+#include "rules.h"
 #include "draw.h"
 #include "constants.h"
 #include <vector>
@@ -7,52 +9,69 @@
 #include <cstdlib>
 #include <ctime>
 #include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cctype>
+#include <limits>
 #include <SFML/Graphics.hpp>
 
 using namespace lapiday;
 using namespace std;
 
-int main() {
-	srand(time(NULL));
-	vector<snowflake::line> lines;
-	vector<snowflake::line>::size_type linecount;
+/**
+ * Parameters of the random branching, known
+ * at compile time
+ */
+struct branching_constants {
+	static constexpr unsigned int PAIRS = PAIRS_PER_LINE;
+	static constexpr double MIN_SCALE = lapiday::MIN_SCALE;
+	static constexpr double MAX_SCALE = lapiday::MAX_SCALE;
+	static constexpr double ANGLE = PI / 3;
+};
 
-	//Seed a single "spoke"
-	lines.push_back(snowflake::line(snowflake::scale(BASE_LENGTH)));
-
-	//Iterate
-	//vector<snowflake::line> newlines;
-	double distance; //Distance from parent line (0 to 1)
-	double scale; //Scale factor (0 to 1)
-	for(unsigned int i = 0; i < ITERATION_COUNT; i++) {
-		linecount = lines.size();
-		for(vector<snowflake::line>::size_type j = 0; j < linecount; j++) {
-			if(!lines[j].completed) {
-				for(unsigned int k = 0; k < PAIRS_PER_LINE; k++) {
-					//Distance must be in the k-th part
-					distance = ((static_cast<double>(rand()) / RAND_MAX) + k) / PAIRS_PER_LINE;
-					scale = MIN_SCALE + (static_cast<double>(rand()) / RAND_MAX) * (MAX_SCALE - MIN_SCALE);
-					lines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, distance) * snowflake::rotate(PI / 3) * snowflake::scale(scale)));
-					lines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, distance) * snowflake::rotate(-PI / 3) * snowflake::scale(scale)));
-				}
-				lines[j].completed = true;
-			}
+int main(int argc, char* argv[]) {
+	typedef snowflake::basic_line<scalar> line;
+	typedef snowflake::basic_affine<scalar> affine;
+	//The same seed always gives the same snowflake
+	uint64_t seed = time(NULL);
+	if(argc > 1) {
+		//strtoull() would read a bad seed as 0, or as
+		//the largest value if it is too large
+		char* end;
+		errno = 0;
+		unsigned long long value = strtoull(argv[1], &end, 10);
+		if(!isdigit(static_cast<unsigned char>(argv[1][0])) || (*end != '\0') || (errno == ERANGE)) {
+			cout << "Seed must be a whole number from 0 to " << numeric_limits<uint64_t>::max() << endl;
+			return 1;
 		}
+		seed = value;
 	}
+	cout << "Seed: " << seed << endl;
 
-	//Create remaining "spokes"
-	linecount = lines.size();
-	for(vector<snowflake::line>::size_type i = 0; i < linecount; i++) {
-		for(int j = 1; j < 6; j++) {
-			lines.push_back(snowflake::line(snowflake::rotate(PI / 3 * j) * lines[i].transformation));
+	//Seed a single "spoke"
+	//Lines are in pixels, so with adaptive depth,
+	//lines shorter than MIN_LINE_PIXELS are not split
+	const unsigned int levels = (MIN_LINE_PIXELS > 0) ? MAX_ITERATION_COUNT : ITERATION_COUNT;
+	snowflake::basic_generator<scalar> spoke(line(affine(snowflake::scale(BASE_LENGTH))), 2 * PAIRS_PER_LINE, levels, MIN_LINE_PIXELS);
+
+	//Iterate, giving each line of the newest level random children
+	//The random numbers of a line depend only on the seed and
+	//where the line is, so the lines can be split between threads
+	//The parameters are constants, so the rule set is specialized
+	//for them (snowflake::basic_rule_set::branching() takes them
+	//at run time instead)
+	const snowflake::basic_static_branching<scalar, branching_constants> rules(seed);
+	for(unsigned int i = 0; i < levels; i++) {
+		spoke.grow_static(rules);
+		if(spoke.level_begin(i + 1) == spoke.level_end(i + 1)) {
+			//Every line is too short to split
+			break;
 		}
 	}
 
-	//Translate all points
-	linecount = lines.size();
-	for(vector<snowflake::line>::size_type i = 0; i < linecount; i++) {
-		lines[i].transformation = snowflake::translate(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2) * lines[i].transformation;
-	}
+	//The remaining "spokes" are copies of this one,
+	//made while drawing
+	const vector<snowflake::affine> spokes = snowflake::symmetry(6);
 
 	//Draw
 #ifndef LAPIDAY_RENDER_TO_FILE
@@ -68,10 +87,8 @@ int main() {
 #endif
 
 	target.clear(BACKGROUND_COLOR);
-	linecount = lines.size();
-	for(vector<snowflake::line>::size_type i = 0; i < linecount; i++) {
-		draw_line(target, lines[i], WINDOW_HEIGHT);
-	}
+	//Translate all points to the center while drawing
+	draw_lines(target, spoke.lines(), spokes, snowflake::translate(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2), WINDOW_HEIGHT);
 	target.display();
 
 #ifndef LAPIDAY_RENDER_TO_FILE
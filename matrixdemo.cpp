@@ -1,6 +1,10 @@
 #include "matrix.h"
+#include "lu.h"
+#include "view.h"
+#include "io.h"
 #include <iostream>
 #include <cstddef> //For size_t
+#include <sstream>
 
 //lapiday = Linear Algebra Pi Day
 using namespace lapiday::matrix; //For matrix code
@@ -132,24 +136,61 @@ int main() {
 	cout << "Anything to the zeroth power..." << endl;
 	cout << (elem ^ 0) << endl;
 
-	/*
-	 * Note: It is possible to use a negative exponent,
-	 * in which case the inverse is used.
-	 * However, inverting a matrix has not yet been
-	 * implemented, so it will not be demonstrated.
-	 */
+	//Find the determinant and the inverse
+	cout << "Determinant of the elementary matrix: " << elem.determinant() << endl;
+	cout << "Inverse of the elementary matrix:" << endl;
+	cout << elem.inverse() << endl;
+
+	//A negative exponent uses the inverse
+	cout << "Elementary matrix to the power of -2:" << endl;
+	cout << (elem ^ -2) << endl;
+
+	//Decompose a matrix once to solve several systems of equations
+	//Each column of the right-hand side is a separate system
+	lu decomposition(elem);
+	matrix rhs(ROWS, 2);
+	for(size_t i = 0; i < ROWS; i++) {
+		rhs(i, 0) = 1;
+		rhs(i, 1) = i;
+	}
+	cout << "Solutions of elem * x = each column of:" << endl;
+	cout << rhs << endl;
+	cout << decomposition.solve(rhs) << endl;
+
+	//Reduce a matrix to reduced row-echelon form
+	matrix rref = m;
+	rref.gauss_jordan();
+	cout << "Reduced row-echelon form:" << endl;
+	cout << rref << endl;
 
 	//Get a submatrix
 	cout << "Submatrix after removing row 0 and column 0:" << endl;
 	cout << m.submatrix(0, 0) << endl;
 
+	//Views refer to the entries of a matrix without copying them
+	const matrix& constm = m;
+	cout << "Block of rows 1-2 and columns 0-1 (a view):" << endl;
+	cout << constm.view().block(1, 0, 2, 2) << endl;
+	cout << "Column 1, transposed (a view):" << endl;
+	cout << constm.view().col(1).transpose() << endl;
+	cout << "Transpose times the matrix, without copying the transpose:" << endl;
+	cout << constm.view().transpose() * m << endl;
+
+	//Save a matrix in the binary format and read it back
+	//Use an ofstream opened with ios::binary to save it to a file,
+	//and mapped_matrix to use a saved file without reading it
+	stringstream file;
+	write_binary(file, m);
+	matrix loaded;
+	read_binary(file, loaded);
+	cout << "Read back from the binary format:" << endl;
+	cout << loaded << endl;
+
 	/*
 	 * Extras (hopefully they don't need to be explained in great detail):
 	 * - Subtracting matrices, negating matrices, subtract-assign (-=)
-	 * Not yet implemented:
-	 * - Gaussian/Gauss-Jordan elimination
-	 * - Inverse
-	 * - Determinant
+	 * - Adjoint (adjugate) matrix
+	 * - Checking if a matrix is invertible
 	 */
 
 	return 0;
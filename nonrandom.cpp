@@ -1,45 +1,34 @@
 #include "matrix.h"
 #include "snowflake.h"
+#include "generator.h"
+#include "rules.h"
 #include "draw.h"
 #include "constants.h"
 #include <vector>
 #include <iostream>
+#include <cstddef>
 #include <SFML/Graphics.hpp>
 
 using namespace lapiday;
 using namespace std;
 
 int main() {
-	vector<snowflake::line> lines;
-	vector<snowflake::line>::size_type linecount;
+	typedef snowflake::basic_line<scalar> line;
+	typedef snowflake::basic_affine<scalar> affine;
+	//Setup one "spoke", copied to the other five while drawing
+	const line spoke(affine(snowflake::scale(BASE_LENGTH)));
+	const vector<snowflake::affine> spokes = snowflake::symmetry(6);
 
-	//Setup six "spokes"
-	for(int i = 0; i < 6; i++) {
-		lines.push_back(snowflake::line(snowflake::rotate(PI / 3 * i) * snowflake::scale(BASE_LENGTH)));
-	}
+	//Transformations from a line to each of its children,
+	//computed once
+	const snowflake::basic_rule_set<scalar> rules = snowflake::basic_rule_set<scalar>::koch();
 
-	//Iterate
-	vector<snowflake::line> newlines;
-	for(unsigned int i = 0; i < ITERATION_COUNT; i++) {
-		linecount = lines.size();
-		for(vector<snowflake::line>::size_type j = 0; j < linecount; j++) {
-			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::scale(THIRD)));
-			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, THIRD) * snowflake::scale(THIRD)));
-			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, 2 * THIRD) * snowflake::scale(THIRD)));
-			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD)));
-			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD)));
-			newlines.push_back(snowflake::line(lines[j].transformation * snowflake::translate(0, 2 * THIRD) * snowflake::rotate(PI / 3) * snowflake::scale(THIRD)));
-			newlines.push_back(lines[j].transformation * snowflake::translate(0, 2 * THIRD) * snowflake::rotate(-PI / 3) * snowflake::scale(THIRD));
-		}
-		lines = newlines;
-		newlines.clear();
-	}
-
-	//Translate all points
-	linecount = lines.size();
-	for(vector<snowflake::line>::size_type i = 0; i < linecount; i++) {
-		lines[i].transformation = snowflake::translate(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2) * lines[i].transformation;
-	}
+	//Only the last level is drawn, so walk to it depth-first
+	//instead of storing every level
+	//Lines are in pixels, so with adaptive depth, lines
+	//shorter than MIN_LINE_PIXELS are drawn instead of split
+	const unsigned int levels = (MIN_LINE_PIXELS > 0) ? MAX_ITERATION_COUNT : ITERATION_COUNT;
+	snowflake::basic_walker<scalar> walker(&spoke, 1, rules, levels, MIN_LINE_PIXELS);
 
 	//Draw
 #ifndef LAPIDAY_RENDER_TO_FILE
@@ -55,9 +44,14 @@ int main() {
 #endif
 
 	target.clear(BACKGROUND_COLOR);
-	linecount = lines.size();
-	for(vector<snowflake::line>::size_type i = 0; i < linecount; i++) {
-		draw_line(target, lines[i], WINDOW_HEIGHT);
+	//Translate all points to the center while drawing,
+	//a batch of lines at a time
+	const size_t BATCH_SIZE = 4096;
+	vector<line> lines(BATCH_SIZE);
+	size_t count;
+	while((count = walker.next_batch(&lines[0], BATCH_SIZE)) > 0) {
+		lines.resize(count);
+		draw_lines(target, lines, spokes, snowflake::translate(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2), WINDOW_HEIGHT);
 	}
 	target.display();
 